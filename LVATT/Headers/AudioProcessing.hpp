@@ -0,0 +1,730 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <cstdint>
+#include <numeric>
+#include <numbers>
+#include <functional>
+
+#include "Common.hpp"
+#include "FFT.hpp"
+#include "WAV.hpp"
+#include "SampleStorage.hpp"
+
+/// <summary>
+/// Streaming automatic gain control (AGC).
+/// the FM discriminator gives out audio in radians (±π), this brings it into a range that the 16 bit WAV conversion and whisper can use.
+/// gain gets calculated once per block (from the peak of the block and the lookahead blocks after it) and is linearly ramped inside the block,
+/// so every sample is only touched once by simple loops that the compiler can vectorise
+/// </summary>
+class AutomaticGainControl
+{
+public:
+	static constexpr size_t BlockSize = 64; /* 4ms at 16KHz */
+
+	/// <summary>
+	/// creates AGC
+	/// </summary>
+	/// <param name="sampleRate">- sample rate of the audio</param>
+	/// <param name="attackMs">- time constant used when the gain has to go down (signal got louder)</param>
+	/// <param name="releaseMs">- time constant used when the gain has to go up (signal got quieter)</param>
+	/// <param name="lookaheadMs">- how far ahead to look for peaks, the output gets delayed by this much</param>
+	/// <param name="targetLevel">- peak level (of full scale) the AGC aims for</param>
+	/// <param name="maxGain">- max gain, stops silence from getting boosted into noise</param>
+	AutomaticGainControl(const size_t& sampleRate, const float& attackMs = 5.0f, const float& releaseMs = 300.0f, const float& lookaheadMs = 8.0f, const float& targetLevel = 0.7f, const float& maxGain = 64.0f)
+	{
+		AttackCoefficient = TimeConstantToCoefficient(attackMs, sampleRate);
+		ReleaseCoefficient = TimeConstantToCoefficient(releaseMs, sampleRate);
+		LookaheadBlocks = (size_t)std::ceil((lookaheadMs * 0.001f * sampleRate) / BlockSize);
+		TargetLevel = targetLevel;
+		MaxGain = maxGain;
+	}
+
+	/// <summary>
+	/// processes a chunk of audio. Output is delayed by the lookahead, so less samples then given can come out.
+	/// at most count samples get written, so input and output can be the same array
+	/// </summary>
+	/// <param name="input">- audio in</param>
+	/// <param name="count">- amount of samples in input</param>
+	/// <param name="output">- audio out (can be the same as input)</param>
+	/// <returns>amount of samples written to output</returns>
+	size_t Process(const float* input, const size_t& count, float* output)
+	{
+		/* copy the input first, this is what makes in place processing possible */
+		Pending.insert(Pending.end(), input, input + count);
+		UpdatePeaks();
+
+		return Emit(output, count, false);
+	}
+
+	/// <summary>
+	/// writes out all the audio that was still waiting for lookahead (call at the end of the stream)
+	/// </summary>
+	/// <param name="output">- audio out, needs room for PendingCount() samples</param>
+	/// <returns>amount of samples written to output</returns>
+	size_t Flush(float* output)
+	{
+		size_t written = Emit(output, PendingCount(), true);
+
+		Reset();
+		return written;
+	}
+
+	/// <summary>
+	/// amount of samples that were taken in, but not given out yet
+	/// </summary>
+	size_t PendingCount()
+	{
+		return Pending.size() - BlockBase - BlockOffset;
+	}
+
+	/// <summary>
+	/// resets state, so the AGC can be used on another stream
+	/// </summary>
+	void Reset()
+	{
+		Pending.clear();
+		Peaks.clear();
+		BlockBase = 0;
+		BlockOffset = 0;
+		InBlock = false;
+		Primed = false;
+		Gain = 1.0f;
+	}
+
+private:
+	float AttackCoefficient;
+	float ReleaseCoefficient;
+	size_t LookaheadBlocks;
+	float TargetLevel;
+	float MaxGain;
+
+	float Gain = 1.0f;		/* gain at the end of the last block */
+	bool Primed = false;	/* false until the first block, so the stream doesn't start with an attack from unity gain */
+
+	std::vector<float> Pending;	/* samples which still have to be given out */
+	std::deque<float> Peaks;	/* peak of each complete block, starting from BlockBase (the front one drops off every block) */
+	size_t BlockBase = 0;		/* position of the current block in Pending */
+
+	/* current block (can be given out over multiple Process calls) */
+	bool InBlock = false;
+	size_t BlockLength = 0;
+	size_t BlockOffset = 0;
+	float RampStart = 1.0f;
+	float RampStep = 0.0f;
+
+	static float TimeConstantToCoefficient(const float& timeMs, const size_t& sampleRate)
+	{
+		/* coefficient is per block, as the gain only gets updated once per block */
+		return std::exp(-float(BlockSize) / std::max(timeMs * 0.001f * sampleRate, 1.0f));
+	}
+
+	static float BlockPeak(const float* data, const size_t& count)
+	{
+		float peak = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			float value = std::fabs(data[i]);
+			peak = value > peak ? value : peak;
+		}
+		return peak;
+	}
+
+	/// <summary>
+	/// calculates the peaks of all new complete blocks
+	/// </summary>
+	void UpdatePeaks()
+	{
+		size_t completeBlocks = (Pending.size() - BlockBase) / BlockSize;
+
+		for (size_t i = Peaks.size(); i < completeBlocks; i++)
+		{
+			Peaks.push_back(BlockPeak(Pending.data() + BlockBase + i * BlockSize, BlockSize));
+		}
+	}
+
+	/// <summary>
+	/// calculates the gain ramp for the block at BlockBase
+	/// </summary>
+	void StartBlock(const bool& flushing)
+	{
+		BlockLength = std::min(BlockSize, Pending.size() - BlockBase);
+		BlockOffset = 0;
+		InBlock = true;
+
+		/* while flushing, the last block can be partial, so it doesn't have a peak yet */
+		if (Peaks.empty() || (flushing && BlockLength < BlockSize))
+		{
+			Peaks.push_front(BlockPeak(Pending.data() + BlockBase, BlockLength));
+		}
+
+		size_t window = std::min(LookaheadBlocks + 1, Peaks.size());
+		float peak = std::max(*std::max_element(Peaks.begin(), Peaks.begin() + window), 1e-9f);
+
+		float target = std::min(TargetLevel / peak, MaxGain);
+
+		if (!Primed)
+		{
+			Gain = target;
+			Primed = true;
+		}
+
+		float coefficient = target < Gain ? AttackCoefficient : ReleaseCoefficient;
+		float nextGain = target + (Gain - target) * coefficient;
+
+		/* never let the current block go over full scale, even if the smoothing didn't catch up yet */
+		float ceiling = 1.0f / std::max(Peaks[0], 1e-9f);
+
+		RampStart = std::min(Gain, ceiling);
+		RampStep = (std::min(nextGain, ceiling) - RampStart) / float(BlockLength);
+
+		Gain = nextGain;
+	}
+
+	/// <summary>
+	/// gives out samples which have all of their lookahead available (or everything, if flushing)
+	/// </summary>
+	size_t Emit(float* output, const size_t& maxCount, const bool& flushing)
+	{
+		size_t written = 0;
+
+		while (written < maxCount)
+		{
+			if (!InBlock)
+			{
+				if (BlockBase >= Pending.size())
+				{
+					break;
+				}
+
+				if (!flushing && Peaks.size() < LookaheadBlocks + 1)
+				{
+					break;
+				}
+
+				StartBlock(flushing);
+			}
+
+			size_t count = std::min(BlockLength - BlockOffset, maxCount - written);
+			const float* in = Pending.data() + BlockBase + BlockOffset;
+			float* out = output + written;
+			float start = RampStart + RampStep * float(BlockOffset);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				out[i] = in[i] * (start + RampStep * float(i));
+			}
+
+			BlockOffset += count;
+			written += count;
+
+			if (BlockOffset == BlockLength)
+			{
+				BlockBase += BlockLength;
+				BlockOffset = 0;
+				Peaks.pop_front();
+				InBlock = false;
+			}
+		}
+
+		/* drop samples that were already given out, only every so often so it doesn't move memory every call */
+		if (BlockBase >= 8192 && BlockBase * 2 >= Pending.size())
+		{
+			Pending.erase(Pending.begin(), Pending.begin() + BlockBase);
+			BlockBase = 0;
+		}
+
+		return written;
+	}
+};
+
+const size_t AgcChunkSize = 1 << 14; /* samples given to the AGC at a time, keeps its pending buffer small */
+
+/// <summary>
+/// runs the AGC over a whole audio array in place, chunk by chunk like a stream (so only about a chunk is ever held in the AGC)
+/// </summary>
+/// <param name="audio">- audio to normalise</param>
+/// <param name="agc">- AGC to use</param>
+/// <param name="blockOut">- if set, gets every chunk (already written back into audio) as soon as the AGC gives it out, for writing the audio out while it is still being made</param>
+inline void ApplyAutomaticGainControl(ArrayWrapper<float>& audio, AutomaticGainControl& agc, const std::function<void(const float*, const size_t&)>& blockOut = nullptr)
+{
+	/* output lags the input, so writing behind the read position never touches samples that weren't read yet */
+	size_t written = 0;
+	for (size_t read = 0; read < audio.size; read += AgcChunkSize)
+	{
+		size_t count = agc.Process(audio.data + read, std::min(AgcChunkSize, audio.size - read), audio.data + written);
+
+		if (blockOut && count != 0)
+		{
+			blockOut(audio.data + written, count);
+		}
+		written += count;
+	}
+
+	size_t count = agc.Flush(audio.data + written);
+	if (blockOut && count != 0)
+	{
+		blockOut(audio.data + written, count);
+	}
+}
+
+/// <summary>
+/// STFT based noise reduction (spectral subtraction with a Wiener style gain).
+/// NFM voice is band limited to ~3KHz, so anything above VoiceBandHz is noise. Frames with mostly high band energy are "squelch closed" (no speech),
+/// the noise spectrum shape is learned from those, and for every frame it gets scaled to that frame's own high band energy.
+/// Squelch closed frames get muted down to the gain floor, which stops whisper from trying (and retrying) to decode noise.
+/// frames are independent, so they get processed in parallel
+/// </summary>
+class SpectralNoiseReducer
+{
+public:
+	static constexpr size_t FrameSize = 512;			/* 32ms at 16KHz */
+	static constexpr size_t HopSize = FrameSize / 2;
+	static constexpr size_t BinCount = FrameSize / 2 + 1;
+
+	/// <summary>
+	/// creates noise reducer
+	/// </summary>
+	/// <param name="sampleRate">- sample rate of the audio</param>
+	/// <param name="overSubtraction">- how much the noise estimate gets multiplied by before subtracting (more = less noise, more artifacts)</param>
+	/// <param name="gainFloor">- lowest gain, stops "musical noise" and is how much squelch closed frames get muted by</param>
+	/// <param name="squelchRatio">- fraction of energy above VoiceBandHz at which a frame counts as squelch closed</param>
+	/// <param name="voiceBandHz">- top of the voice band</param>
+	SpectralNoiseReducer(const size_t& sampleRate, const float& overSubtraction = 1.5f, const float& gainFloor = 0.1f, const float& squelchRatio = 0.3f, const float& voiceBandHz = 3400.0f)
+		: Transform(FrameSize)
+	{
+		SampleRate = sampleRate;
+		OverSubtraction = overSubtraction;
+		GainFloor = gainFloor;
+		SquelchRatio = squelchRatio;
+		VoiceBin = std::min(size_t(voiceBandHz * FrameSize / sampleRate), BinCount - 1);
+
+		/* square root Hann on both analysis and synthesis, squared it is Hann which adds up to 1 at 50% overlap */
+		Window = HannWindow(FrameSize);
+		for (float& value : Window)
+		{
+			value = std::sqrt(value);
+		}
+	}
+
+	/// <summary>
+	/// removes noise from audio. frames get loaded out of the compact input as they are analysed, so only the output is full float
+	/// </summary>
+	/// <param name="audio">- audio to clean up</param>
+	/// <returns>cleaned up audio</returns>
+	ArrayWrapper<float> Process(const CompactBuffer& audio)
+	{
+		if (audio.size() == 0)
+		{
+			return ArrayWrapper<float>();
+		}
+
+		/* frame k covers [(k-1)*HopSize, (k+1)*HopSize), so every sample is in 2 frames */
+		size_t frameCount = (audio.size() + HopSize - 1) / HopSize + 1;
+
+		std::vector<float> highBandEnergy(frameCount);
+		std::vector<float> highBandRatio(frameCount);
+
+		/* first pass: squelch state of every frame and the noise shape (from squelch closed frames) */
+		std::mutex noiseMutex;
+		std::vector<double> noiseShape(BinCount, 0.0);
+		size_t noiseFrames = 0;
+
+		ParallelFor(frameCount, [&](size_t begin, size_t end)
+			{
+				std::vector<float> real(FrameSize), imag(FrameSize);
+				std::vector<double> localShape(BinCount, 0.0);
+				size_t localFrames = 0;
+
+				for (size_t k = begin; k < end; k++)
+				{
+					AnalyseFrame(audio, k, real.data(), imag.data());
+
+					float total = 0.0f;
+					float high = 0.0f;
+					for (size_t bin = 1; bin < BinCount; bin++)
+					{
+						float power = real[bin] * real[bin] + imag[bin] * imag[bin];
+						total += power;
+						high += bin >= VoiceBin ? power : 0.0f;
+					}
+
+					highBandEnergy[k] = high;
+					highBandRatio[k] = total > 0.0f ? high / total : 1.0f;
+
+					if (high > 0.0f && highBandRatio[k] >= SquelchRatio)
+					{
+						for (size_t bin = 0; bin < BinCount; bin++)
+						{
+							localShape[bin] += (real[bin] * real[bin] + imag[bin] * imag[bin]) / high;
+						}
+						localFrames++;
+					}
+				}
+
+				std::lock_guard<std::mutex> lock(noiseMutex);
+				for (size_t bin = 0; bin < BinCount; bin++)
+				{
+					noiseShape[bin] += localShape[bin];
+				}
+				noiseFrames += localFrames;
+			});
+
+		/* noise shape, normalised to the high band energy. If the squelch never closed, assume white noise */
+		std::vector<float> shape(BinCount);
+		for (size_t bin = 0; bin < BinCount; bin++)
+		{
+			shape[bin] = noiseFrames != 0 ? float(noiseShape[bin] / double(noiseFrames)) : 1.0f / float(BinCount - VoiceBin);
+		}
+
+		/* squelch only counts as closed if the frames around it are noise as well, so the start and end of words don't get cut off */
+		std::vector<uint8_t> squelchClosed(frameCount);
+		for (size_t k = 0; k < frameCount; k++)
+		{
+			bool closed = true;
+			for (size_t j = (k >= SquelchHold ? k - SquelchHold : 0); j <= std::min(k + SquelchHold, frameCount - 1); j++)
+			{
+				closed &= highBandRatio[j] >= SquelchRatio;
+			}
+			squelchClosed[k] = closed;
+		}
+
+		SquelchClosed = squelchClosed;
+		AudioSize = audio.size();
+
+		/* second pass: apply gains and overlap add. even frames don't overlap each other (same with odd), so each set can be done in parallel */
+		ArrayWrapper<float> outArray(audio.size());
+
+		for (size_t parity = 0; parity < 2; parity++)
+		{
+			size_t setCount = (frameCount + 1 - parity) / 2;
+
+			ParallelFor(setCount, [&](size_t begin, size_t end)
+				{
+					std::vector<float> real(FrameSize), imag(FrameSize);
+
+					for (size_t i = begin; i < end; i++)
+					{
+						size_t k = i * 2 + parity;
+						AnalyseFrame(audio, k, real.data(), imag.data());
+
+						for (size_t bin = 0; bin < BinCount; bin++)
+						{
+							float gain = GainFloor;
+
+							if (!squelchClosed[k])
+							{
+								float power = real[bin] * real[bin] + imag[bin] * imag[bin];
+								float noise = OverSubtraction * shape[bin] * highBandEnergy[k];
+								float snr = noise > 0.0f ? std::max(power / noise - 1.0f, 0.0f) : 1e9f;
+								gain = std::max(snr / (1.0f + snr), GainFloor);
+							}
+
+							real[bin] *= gain;
+							imag[bin] *= gain;
+
+							/* keep the spectrum conjugate symmetric, so the output stays real */
+							if (bin != 0 && bin != FrameSize / 2)
+							{
+								real[FrameSize - bin] *= gain;
+								imag[FrameSize - bin] *= gain;
+							}
+						}
+
+						SynthesiseFrame(outArray, k, real.data(), imag.data());
+					}
+				});
+		}
+
+		return outArray;
+	}
+
+	/// <summary>
+	/// parts of the last processed audio where the squelch was open (transmissions), short gaps get bridged and very short bursts dropped
+	/// </summary>
+	/// <param name="mergeGap">- gaps shorter then this (seconds) are counted as part of the same transmission</param>
+	/// <param name="minLength">- transmissions shorter then this (seconds) get dropped</param>
+	/// <returns>transmissions, in samples</returns>
+	std::vector<AudioSpan> GetTransmissions(const double& mergeGap = 0.5, const double& minLength = 0.3)
+	{
+		std::vector<AudioSpan> spans;
+
+		/* frame k is centred on sample k * HopSize */
+		for (size_t k = 0; k < SquelchClosed.size(); k++)
+		{
+			if (SquelchClosed[k])
+			{
+				continue;
+			}
+
+			size_t start = (k * HopSize > HopSize / 2) ? k * HopSize - HopSize / 2 : 0;
+			size_t end = std::min(k * HopSize + HopSize / 2, AudioSize);
+
+			if (!spans.empty() && start <= spans.back().End + size_t(mergeGap * SampleRate))
+			{
+				spans.back().End = end;
+			}
+			else
+			{
+				spans.push_back({ start, end });
+			}
+		}
+
+		std::erase_if(spans, [&](const AudioSpan& span) { return span.End - span.Start < size_t(minLength * SampleRate); });
+
+		return spans;
+	}
+
+private:
+	static constexpr size_t SquelchHold = 2;
+
+	size_t SampleRate;
+	float OverSubtraction;
+	float GainFloor;
+	float SquelchRatio;
+	size_t VoiceBin;
+
+	FFT Transform;
+	std::vector<float> Window;
+
+	/* squelch state of the last processed audio */
+	std::vector<uint8_t> SquelchClosed;
+	size_t AudioSize = 0;
+
+	/// <summary>
+	/// windows frame k and FFTs it
+	/// </summary>
+	void AnalyseFrame(const CompactBuffer& audio, const size_t& k, float* real, float* imag)
+	{
+		ptrdiff_t start = ptrdiff_t(k * HopSize) - ptrdiff_t(HopSize);
+
+		/* the part of the frame inside the audio gets loaded, the first and last frames hang over the ends and are zero there */
+		size_t first = start < 0 ? size_t(-start) : 0;
+		size_t offset = size_t(start + ptrdiff_t(first));
+		size_t count = std::min(FrameSize - first, audio.size() - offset);
+
+		std::fill(real, real + FrameSize, 0.0f);
+		audio.Load(real + first, count, offset);
+
+		for (size_t i = 0; i < FrameSize; i++)
+		{
+			real[i] *= Window[i];
+			imag[i] = 0.0f;
+		}
+
+		/* the FFT object is only read from, so all threads can share it */
+		Transform.Forward(real, imag);
+	}
+
+	/// <summary>
+	/// inverse FFTs frame k, windows it and adds it into the output
+	/// </summary>
+	void SynthesiseFrame(ArrayWrapper<float>& outArray, const size_t& k, float* real, float* imag)
+	{
+		Transform.Inverse(real, imag);
+
+		ptrdiff_t start = ptrdiff_t(k * HopSize) - ptrdiff_t(HopSize);
+
+		for (size_t i = 0; i < FrameSize; i++)
+		{
+			ptrdiff_t position = start + ptrdiff_t(i);
+			if (position >= 0 && size_t(position) < outArray.size)
+			{
+				outArray.data[position] += real[i] * Window[i];
+			}
+		}
+	}
+};
+
+/// <summary>
+/// Polyphase rational resampler (inSampleRate to outSampleRate, reduced to Up/Down).
+/// a Kaiser windowed sinc low pass designed at Up * inSampleRate gets split into Up phases of TapCount taps (more taps when going down in rate, so the transition band stays as narrow),
+/// so each output sample is a single short dot product against the input, and only the samples that are actually kept get calculated.
+/// each phase is stored reversed, so the dot product runs forward over contiguous memory (which the compiler vectorises).
+/// outputs don't depend on each other, so they get calculated in parallel
+/// </summary>
+class PolyphaseResampler
+{
+public:
+	static constexpr size_t TapsPerPhase = 32;		/* taps per phase when not going down in rate */
+	static constexpr double KaiserBeta = 8.0;		/* ~80dB stop band */
+	static constexpr double PassBand = 0.9;		/* cut off as a fraction of the lower of the 2 nyquists */
+
+	/// <summary>
+	/// designs the resampler
+	/// </summary>
+	/// <param name="inSampleRate">- sample rate of the input</param>
+	/// <param name="outSampleRate">- sample rate wanted</param>
+	PolyphaseResampler(const size_t& inSampleRate, const size_t& outSampleRate)
+	{
+		if (inSampleRate == 0 || outSampleRate == 0)
+		{
+			throw std::invalid_argument("sample rates have to be above 0");
+		}
+
+		size_t divisor = std::gcd(inSampleRate, outSampleRate);
+		Up = outSampleRate / divisor;
+		Down = inSampleRate / divisor;
+		TapCount = TapsPerPhase * ((Down + Up - 1) / Up);
+
+		/* prototype filter at Up * inSampleRate, cut off at the lower nyquist */
+		size_t length = Up * TapCount;
+		double cutOff = PassBand * 0.5 / double(std::max(Up, Down));
+		double centre = double(length - 1) / 2.0;
+		double windowNorm = std::cyl_bessel_i(0.0, KaiserBeta);
+
+		std::vector<double> prototype(length);
+		for (size_t i = 0; i < length; i++)
+		{
+			double x = double(i) - centre;
+			double sinc = (x == 0.0) ? 2.0 * cutOff : std::sin(2.0 * std::numbers::pi * cutOff * x) / (std::numbers::pi * x);
+			double ratio = x / (centre + 1.0);
+			double window = std::cyl_bessel_i(0.0, KaiserBeta * std::sqrt(1.0 - ratio * ratio)) / windowNorm;
+
+			/* times Up, as zero stuffing divides the level by Up */
+			prototype[i] = sinc * window * double(Up);
+		}
+
+		/* phase p has taps p, p + Up, p + 2Up..., stored reversed */
+		Phases.resize(length);
+		for (size_t phase = 0; phase < Up; phase++)
+		{
+			for (size_t tap = 0; tap < TapCount; tap++)
+			{
+				Phases[phase * TapCount + (TapCount - 1 - tap)] = float(prototype[phase + tap * Up]);
+			}
+		}
+
+		/* filter delay (in Up rate samples), taken off so the output lines up with the input */
+		Delay = length / 2;
+	}
+
+	/// <summary>
+	/// how many samples Process() gives out for an input of a set size
+	/// </summary>
+	/// <param name="inCount">- input size</param>
+	/// <returns>output size</returns>
+	size_t OutputCount(const size_t& inCount)
+	{
+		return (inCount * Up + Down - 1) / Down;
+	}
+
+	/// <summary>
+	/// resamples a whole signal
+	/// </summary>
+	/// <param name="in">- input signal</param>
+	/// <param name="inCount">- input size</param>
+	/// <returns>resampled signal</returns>
+	ArrayWrapper<float> Process(const float* in, const size_t& inCount)
+	{
+		ArrayWrapper<float> outArray(OutputCount(inCount));
+
+		ParallelFor(outArray.size, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					outArray.data[i] = Calculate(in, inCount, i);
+				}
+			});
+
+		return outArray;
+	}
+
+private:
+	size_t Up;
+	size_t Down;
+	size_t Delay;
+	size_t TapCount;
+	std::vector<float> Phases;
+
+	float Calculate(const float* in, const size_t& inCount, const size_t& outIndex)
+	{
+		size_t position = outIndex * Down + Delay;
+		size_t newest = position / Up; /* newest input sample under the filter */
+		const float* taps = Phases.data() + (position % Up) * TapCount;
+
+		/* fast path, the whole filter is inside the input */
+		if (newest + 1 >= TapCount && newest < inCount)
+		{
+			const float* window = in + newest + 1 - TapCount;
+			float sum = 0.0f;
+			for (size_t tap = 0; tap < TapCount; tap++)
+			{
+				sum += taps[tap] * window[tap];
+			}
+			return sum;
+		}
+
+		/* edges, samples outside of the input are 0 */
+		float sum = 0.0f;
+		for (size_t tap = 0; tap < TapCount; tap++)
+		{
+			size_t index = newest + 1 + tap;
+			if (index >= TapCount && index - TapCount < inCount)
+			{
+				sum += taps[tap] * in[index - TapCount];
+			}
+		}
+		return sum;
+	}
+};
+
+/// <summary>
+/// reads an already demodulated audio WAV file (any sample rate, any channel count) straight into whisper ready audio,
+/// mixed down to mono and resampled to outSampleRate. skips the whole IQ front end
+/// </summary>
+/// <param name="filePath">- path to the WAV file</param>
+/// <param name="outSampleRate">- sample rate wanted</param>
+/// <param name="formatOut">- format of the file before resampling (optional)</param>
+/// <returns>audio (empty if the file couldn't be read)</returns>
+ArrayWrapper<float> WavToAudio(const std::filesystem::path& filePath, const size_t& outSampleRate, WavFormat* formatOut = nullptr)
+{
+	WavFormat format;
+	ArrayWrapper<float> audio = ReadFile(filePath, &format);
+
+	if (audio.data == nullptr)
+	{
+		return audio;
+	}
+
+	if (formatOut != nullptr)
+	{
+		*formatOut = format;
+	}
+
+	printf("Read %s (%uHz, %u channels)\n", filePath.string().c_str(), format.SampleRate, format.Channels);
+
+	/* mix down to mono, in place */
+	if (format.Channels > 1)
+	{
+		size_t frameCount = audio.size / format.Channels;
+		float scale = 1.0f / float(format.Channels);
+
+		for (size_t i = 0; i < frameCount; i++)
+		{
+			float sum = 0.0f;
+			for (size_t channel = 0; channel < format.Channels; channel++)
+			{
+				sum += audio[i * format.Channels + channel];
+			}
+			audio[i] = sum * scale;
+		}
+		audio.size = frameCount;
+	}
+
+	if (format.SampleRate == outSampleRate)
+	{
+		return audio;
+	}
+
+	printf("Resampling %uHz to %zuHz\n", format.SampleRate, outSampleRate);
+	PolyphaseResampler resampler(format.SampleRate, outSampleRate);
+	ArrayWrapper<float> outArray = resampler.Process(audio.data, audio.size);
+	audio.Delete();
+
+	return outArray;
+}
@@ -2,6 +2,8 @@
 #include "FileDownloading.hpp"
 
 #include "Common.hpp"
+#include "SampleStorage.hpp"
+#include "ThreadTuning.hpp"
 
 #include <whisper.h>
 
@@ -15,6 +17,17 @@
 #include <iostream>
 #include <format>
 #include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <optional>
+#include <functional>
+#include <numeric>
+#include <cfloat>
+#include <future>
 
 //  500 -> 00:05.000
 // 6000 -> 01:00.000
@@ -37,123 +50,1073 @@ int timestamp_to_sample(int64_t t, int n_samples) {
 	return std::max(0, std::min((int)n_samples - 1, (int)((t * WHISPER_SAMPLE_RATE) / 100)));
 }
 
+inline whisper_context* ctx = nullptr;
+
+inline std::mutex WhisperPrintMutex; /* keeps lines from concurrent jobs from getting mixed up */
+
+inline std::future<whisper_context*> ContextLoading;	/* model being loaded in the background, see PreloadWhisperContext */
+inline std::string ContextLoadingPath;					/* which model ContextLoading is */
+inline std::mutex ContextMutex;
+
+/// <summary>
+/// loads a model from file and prints how long it took.
+/// whisper copies every weight into its own ggml tensors while loading, whatever whisper_model_loader it reads through,
+/// so each process holds its own copy of the model. sharing it between processes would need mmap backed tensors inside whisper.cpp
+/// </summary>
+/// <param name="modelPath">- path to model</param>
+/// <returns>whisper context, nullptr if it failed</returns>
+whisper_context* LoadModelTimed(const std::string& modelPath)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	whisper_context* context = whisper_init_from_file(modelPath.c_str());
+	auto stop = std::chrono::high_resolution_clock::now();
+
+	std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+	printf("Model loading took: %lld milliseconds\n", std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+	return context;
+}
+
 /// <summary>
-/// Used to print transcribed text
+/// starts loading the model on a background thread, so it loads while the first file goes through the DSP instead of after it.
+/// LoadWhisperContext waits for it
 /// </summary>
-/// <param name="ctx">- whisper context</param>
-/// <param name="">- whisper state</param>
-/// <param name="n_new">- amount of new segments(?)</param>
-/// <param name="user_data">- user data past in when creating wparams</param>
-void whisper_print_segment_callback(struct whisper_context* ctx, struct whisper_state* /*state*/, int n_new, void* user_data)
+/// <param name="modelPath">- path to model used for transcribing</param>
+void PreloadWhisperContext(const std::string& modelPath)
 {
-	const int n_segments = whisper_full_n_segments(ctx);
+	std::lock_guard<std::mutex> lock(ContextMutex);
 
-	std::string speaker = "";
+	if (ctx == nullptr && !ContextLoading.valid())
+	{
+		ContextLoading = std::async(std::launch::async, LoadModelTimed, modelPath);
+		ContextLoadingPath = modelPath;
+	}
+}
 
-	int64_t t0 = 0;
-	int64_t t1 = 0;
+/// <summary>
+/// loads the model into the shared context, if it isn't already (waits for the background load if one was started,
+/// a background load of a different model gets freed and the requested one loaded instead)
+/// </summary>
+/// <param name="modelPath">- path to model used for transcribing</param>
+/// <returns>true if the context is loaded</returns>
+bool LoadWhisperContext(const std::string& modelPath)
+{
+	std::lock_guard<std::mutex> lock(ContextMutex);
 
-	// print the last n_new segments
-	const int s0 = n_segments - n_new;
+	bool preloaded = ContextLoading.valid();
+	if (preloaded)
+	{
+		whisper_context* context = ContextLoading.get();
 
-	if (s0 == 0) {
-		printf("\n");
+		if (ContextLoadingPath == modelPath)
+		{
+			ctx = context;
+		}
+		else
+		{
+			whisper_free(context);
+			preloaded = false;
+		}
+
+		ContextLoadingPath.clear();
+	}
+
+	if (ctx == nullptr && !preloaded) /* if is nullptr (failed last time or first time loading), load from file */
+	{
+		ctx = LoadModelTimed(modelPath);
 	}
 
-	for (int i = s0; i < n_segments; i++)
+	if (ctx == nullptr)
 	{
-		t0 = whisper_full_get_segment_t0(ctx, i);
-		t1 = whisper_full_get_segment_t1(ctx, i);
+		fprintf(stderr, "error: failed to initialize whisper context\n");
+		return false;
+	}
 
-		printf("[%s --> %s]  %s\n", to_timestamp(t0).c_str(), to_timestamp(t1).c_str(), whisper_full_get_segment_text(ctx, i));
+	return true;
+}
 
-		fflush(stdout);
+/// <summary>
+/// length of the UTF-8 character a byte starts
+/// </summary>
+/// <param name="lead">- first byte of the character</param>
+/// <returns>1 to 4, 0 if the byte can't start a character (continuation or invalid byte)</returns>
+inline size_t Utf8SequenceLength(const unsigned char& lead)
+{
+	if (lead < 0x80) { return 1; }
+	if (lead >= 0xC2 && lead <= 0xDF) { return 2; }
+	if (lead >= 0xE0 && lead <= 0xEF) { return 3; }
+	if (lead >= 0xF0 && lead <= 0xF4) { return 4; }
+	return 0;
+}
+
+/// <summary>
+/// if text ends part way through a UTF-8 character (whisper tokens are BPE bytes, so one character can be split over a few tokens)
+/// </summary>
+inline bool EndsInPartialUtf8(const std::string& text)
+{
+	/* find the start of the last character, at most 3 continuation bytes back */
+	for (size_t back = 1; back <= std::min<size_t>(4, text.size()); back++)
+	{
+		unsigned char byte = static_cast<unsigned char>(text[text.size() - back]);
+		if ((byte & 0xC0) != 0x80)
+		{
+			return Utf8SequenceLength(byte) > back;
+		}
 	}
+
+	return false;
 }
 
-inline whisper_context* ctx = nullptr;
+/// <summary>
+/// one token of a transcribed segment, times in seconds from the start of the audio
+/// </summary>
+struct TranscriptToken
+{
+	double StartTime = 0.0;
+	double EndTime = 0.0;
+	std::string Text;
+	float Probability = 0.0f;
+};
+
+/// <summary>
+/// one transcribed segment, times in seconds from the start of the audio
+/// </summary>
+struct TranscriptSegment
+{
+	double StartTime = 0.0;
+	double EndTime = 0.0;
+	std::string Text;
+	std::string Language;					/* language whisper decoded the segment as (detected, unless one was given) */
+	std::vector<TranscriptToken> Tokens;	/* text tokens of the segment (special tokens left out) */
+};
+
+const int DefaultThreadsPerJob = 4; /* whisper's per job speed up flattens out past a few threads, more jobs at once make use of the rest */
+const size_t DefaultTranscriptionMemoryBudget = size_t(1) << 30; /* bytes of audio allowed to wait for (or be in) transcription before Submit() blocks, ~9.3 hours at 16KHz (see QueuedAudioStorage) */
+const SampleStorage QueuedAudioStorage = SampleStorage::Float16; /* owned job audio waits in the queue as halves, ~66dB below the signal is far under what whisper picks up */
+
+/* Batching (seconds) */
+const double TranscriptionBatchLength = 30.0;		/* whisper works in 30 second windows (and pads anything shorter up to one), so batches are filled up to that */
+const double TranscriptionBatchGap = 2.0;			/* transmissions closer together then this can share a batch */
+const double TranscriptionSpanPadding = 0.25;		/* kept around each transmission, so the first and last words aren't cut */
+const double TranscriptionSplitSearch = 5.0;		/* longer spans get cut at the quietest point in this much audio before the window ends */
+const double TranscriptionSplitFrame = 0.02;		/* frame length used to find that point */
+const double TranscriptionMinBatchLength = 1.1;		/* whisper skips anything under a second, shorter batches get padded with silence when they are decoded */
+
+/* Thread tuning */
+const size_t TuningMaxSlots = 4;		/* most batches at once that get tried, every state holds its own buffers */
+const double TuningClipLength = 10.0;	/* seconds of audio each configuration transcribes */
+
+/// <summary>
+/// amount of jobs to run at the same time, one per DefaultThreadsPerJob threads
+/// </summary>
+/// <param name="threadCount">- total amount of threads</param>
+/// <returns>amount of job slots</returns>
+inline size_t PickJobSlots(const int& threadCount = std::thread::hardware_concurrency())
+{
+	return size_t(std::max(threadCount / DefaultThreadsPerJob, 1));
+}
 
 /// <summary>
-/// transcribes audio stream
+/// groups active parts of the audio into batches which can be transcribed independently.
+/// nearby transmissions share a batch (up to one whisper window), anything longer then a window gets cut at its quietest point.
+/// batches can still be shorter then whisper's one second minimum, those get padded with silence when they are decoded (TranscriptionMinBatchLength)
 /// </summary>
 /// <param name="audio">- audio data</param>
-/// <param name="modelPath">- path to model used for transcribing</param>
-/// <returns>will return none 0 number if failed</returns>
-int TranscribeAudio(const ArrayWrapper<float>& audio, const std::string& modelPath, const std::string& language = "auto", const int& threadCount = std::thread::hardware_concurrency())
+/// <param name="audioSize">- amount of samples</param>
+/// <param name="spans">- active parts of the audio (in order, not overlapping)</param>
+/// <param name="sampleRate">- sample rate of the audio</param>
+/// <returns>batches, in order</returns>
+inline std::vector<AudioSpan> BatchSpans(const float* audio, const size_t& audioSize, const std::vector<AudioSpan>& spans, const int& sampleRate)
 {
-	if (ctx == nullptr) /* if is nullptr (failed last time or first time loading), load from file */
+	size_t padding = size_t(TranscriptionSpanPadding * sampleRate);
+	size_t maxGap = size_t(TranscriptionBatchGap * sampleRate);
+	size_t maxLength = size_t(TranscriptionBatchLength * sampleRate);
+	size_t searchLength = size_t(TranscriptionSplitSearch * sampleRate);
+	size_t frameLength = std::max<size_t>(size_t(TranscriptionSplitFrame * sampleRate), 1);
+
+	std::vector<AudioSpan> merged;
+	for (const AudioSpan& span : spans)
 	{
-		ctx = whisper_init_from_file(modelPath.c_str());
+		size_t start = span.Start > padding ? span.Start - padding : 0;
+		size_t end = std::min(span.End + padding, audioSize);
+
+		if (!merged.empty() && start <= merged.back().End + maxGap && end - merged.back().Start <= maxLength)
+		{
+			merged.back().End = end;
+		}
+		else if (!merged.empty() && start < merged.back().End)
+		{
+			/* padding overlaps the previous batch, but they don't fit together */
+			merged.push_back({ merged.back().End, end });
+		}
+		else
+		{
+			merged.push_back({ start, end });
+		}
 	}
 
-	if (ctx == nullptr)
+	std::vector<AudioSpan> batches;
+	for (AudioSpan span : merged)
 	{
-		fprintf(stderr, "error: failed to initialize whisper context\n");
-		return 3;
+		while (span.End - span.Start > maxLength)
+		{
+			/* quietest frame in the last part of the window */
+			size_t searchStart = span.Start + maxLength - searchLength;
+			size_t cut = span.Start + maxLength;
+			double quietest = DBL_MAX;
+
+			for (size_t frame = searchStart; frame + frameLength <= span.Start + maxLength; frame += frameLength)
+			{
+				double energy = 0.0;
+				for (size_t i = frame; i < frame + frameLength; i++)
+				{
+					energy += double(audio[i]) * audio[i];
+				}
+
+				if (energy < quietest)
+				{
+					quietest = energy;
+					cut = frame + frameLength / 2;
+				}
+			}
+
+			batches.push_back({ span.Start, cut });
+			span.Start = cut;
+		}
+
+		if (span.End > span.Start)
+		{
+			batches.push_back(span);
+		}
+	}
+
+	return batches;
+}
+
+/// <summary>
+/// whisper states sharing the one loaded model (each state only holds its own KV cache and work buffers),
+/// so several pieces of audio can be transcribed at the same time without loading the model more then once
+/// </summary>
+class WhisperStatePool
+{
+public:
+	/// <summary>
+	/// creates the states
+	/// </summary>
+	/// <param name="context">- loaded whisper context, has to outlive the pool</param>
+	/// <param name="stateCount">- amount of states</param>
+	WhisperStatePool(whisper_context* context, const size_t& stateCount)
+	{
+		for (size_t i = 0; i < stateCount; i++)
+		{
+			whisper_state* state = whisper_init_state(context);
+			if (state == nullptr)
+			{
+				fprintf(stderr, "error: failed to create whisper state %zu, continuing with %zu\n", i + 1, States.size());
+				break;
+			}
+
+			States.push_back(state);
+		}
+
+		FreeStates = States;
+	}
+
+	WhisperStatePool(const WhisperStatePool&) = delete;
+	WhisperStatePool& operator=(const WhisperStatePool&) = delete;
+
+	~WhisperStatePool()
+	{
+		for (whisper_state* state : States)
+		{
+			whisper_free_state(state);
+		}
 	}
 
-	// run the inference
+	size_t size()
 	{
-		whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+		return States.size();
+	}
 
-		wparams.print_realtime = false;
-		wparams.language = language.c_str();
-		wparams.translate = true;
-		wparams.n_threads = threadCount;
+	/// <summary>
+	/// takes a state, blocks until one is free
+	/// </summary>
+	whisper_state* Acquire()
+	{
+		std::unique_lock<std::mutex> lock(PoolMutex);
+		StateFreed.wait(lock, [this] { return !FreeStates.empty(); });
 
-		wparams.new_segment_callback = whisper_print_segment_callback;
-		wparams.new_segment_callback_user_data = nullptr;
+		whisper_state* state = FreeStates.back();
+		FreeStates.pop_back();
+		return state;
+	}
 
-		// print some info about the processing
+	/// <summary>
+	/// gives a state back
+	/// </summary>
+	void Release(whisper_state* state)
+	{
 		{
-			printf("processing audio (%d samples, %.1f sec), %d threads, %d processors, lang = %s, task = transcribe%s, %stimestamps = %d ...\n",
-				int(audio.size), float(audio.size) / WHISPER_SAMPLE_RATE,
-				wparams.n_threads, 1,
-				wparams.language,
-				wparams.translate ? " & translate" : "",
-				wparams.tdrz_enable ? "tdrz = 1, " : "",
-				wparams.print_timestamps ? 1 : 0);
+			std::lock_guard<std::mutex> lock(PoolMutex);
+			FreeStates.push_back(state);
+		}
+		StateFreed.notify_one();
+	}
+
+private:
+	std::vector<whisper_state*> States;
+	std::vector<whisper_state*> FreeStates;
+	std::mutex PoolMutex;
+	std::condition_variable StateFreed;
+};
 
-			fprintf(stderr, "\n");
+/* Decoding profiles */
+const int AudioContextPerSecond = 50;	/* encoder positions per second of audio (1500 for whisper's 30 second window) */
+const int AudioContextMargin = 64;		/* positions kept past the end of the audio when the context gets cut down */
+
+/// <summary>
+/// how whisper decodes, trading accuracy for speed. 0 keeps whisper's default for that setting
+/// </summary>
+struct DecodingProfile
+{
+	std::string Name;
+	whisper_sampling_strategy Strategy = WHISPER_SAMPLING_GREEDY;
+	int BestOf = 0;						/* candidates sampled at each fallback temperature (greedy) */
+	int BeamSize = 0;					/* beams kept (beam search) */
+	float TemperatureIncrement = 0.0f;	/* temperature step when a decode fails whisper's entropy/log probability checks */
+	bool NoFallback = false;			/* take the first decode as it is, no retrying at higher temperatures */
+	bool ShortAudioContext = false;		/* only encode as much of the 30 second window as the audio fills, faster but less accurate */
+	bool Translate = true;				/* translate into english (whisper's translate task), otherwise transcribe in the spoken language */
+};
+
+/// <summary>
+/// profiles to pick from. balanced is whisper's defaults (what was always used)
+/// </summary>
+inline const std::vector<DecodingProfile> DecodingProfiles =
+{
+	{ "fast", WHISPER_SAMPLING_GREEDY, 1, 0, 0.0f, true, true },
+	{ "balanced", WHISPER_SAMPLING_GREEDY },
+	{ "accurate", WHISPER_SAMPLING_BEAM_SEARCH, 5, 5, 0.1f, false, false },
+};
+
+const size_t DefaultDecodingProfile = 1; /* balanced */
+
+/// <summary>
+/// finds a profile by name
+/// </summary>
+/// <param name="name">- profile name</param>
+/// <returns>profile, nullptr if there is none with that name</returns>
+inline const DecodingProfile* FindDecodingProfile(const std::string& name)
+{
+	for (const DecodingProfile& profile : DecodingProfiles)
+	{
+		if (profile.Name == name)
+		{
+			return &profile;
 		}
+	}
+
+	return nullptr;
+}
 
-		if (whisper_full_parallel(ctx, wparams, audio.data, audio.size, 1) != 0) {
-			fprintf(stderr, "failed to process audio\n");
-			return 10;
+/// <summary>
+/// creates whisper's parameters for a profile
+/// </summary>
+/// <param name="profile">- decoding profile</param>
+/// <param name="sampleCount">- amount of samples that get decoded with them (for the audio context)</param>
+/// <returns>parameters</returns>
+inline whisper_full_params ProfileParameters(const DecodingProfile& profile, const size_t& sampleCount)
+{
+	whisper_full_params wparams = whisper_full_default_params(profile.Strategy);
+	wparams.translate = profile.Translate;
+
+	if (profile.BestOf > 0)
+	{
+		wparams.greedy.best_of = profile.BestOf;
+	}
+
+	if (profile.BeamSize > 0)
+	{
+		wparams.beam_search.beam_size = profile.BeamSize;
+	}
+
+	if (profile.NoFallback)
+	{
+		wparams.temperature_inc = 0.0f;
+	}
+	else if (profile.TemperatureIncrement > 0.0f)
+	{
+		wparams.temperature_inc = profile.TemperatureIncrement;
+	}
+
+	/* the encoder always runs over the whole window, most of which is padding for a short transmission */
+	if (profile.ShortAudioContext)
+	{
+		int audioContext = int(sampleCount * AudioContextPerSecond / WHISPER_SAMPLE_RATE) + AudioContextMargin;
+		if (audioContext < int(TranscriptionBatchLength) * AudioContextPerSecond)
+		{
+			wparams.audio_ctx = audioContext;
 		}
 	}
-	printf("\n");
 
-	whisper_print_timings(ctx);
+	return wparams;
+}
+
+/// <summary>
+/// transcribes audio on a whisper state (the shared context's model, the state's own buffers)
+/// </summary>
+/// <param name="state">- whisper state, only one job may use it at a time</param>
+/// <param name="samples">- audio data (WHISPER_SAMPLE_RATE)</param>
+/// <param name="sampleCount">- amount of samples</param>
+/// <param name="language">- language of the audio</param>
+/// <param name="threadCount">- threads for this job</param>
+/// <param name="segmentsOut">- gets filled with the transcribed segments</param>
+/// <param name="timeOffset">- added to the segment times (seconds), for audio cut out of a longer file</param>
+/// <param name="profile">- how to decode</param>
+/// <returns>will return none 0 number if failed</returns>
+int TranscribeWithState(whisper_state* state, const float* samples, const size_t& sampleCount, const std::string& language, const int& threadCount, std::vector<TranscriptSegment>& segmentsOut,
+	const double& timeOffset = 0.0, const DecodingProfile& profile = DecodingProfiles[DefaultDecodingProfile])
+{
+	whisper_full_params wparams = ProfileParameters(profile, sampleCount);
+
+	wparams.print_realtime = false;
+	wparams.print_progress = false;
+	wparams.language = language.c_str();
+	wparams.n_threads = threadCount;
+	wparams.token_timestamps = true; /* worked out from the decode that already happens, no extra pass */
+
+	if (whisper_full_with_state(ctx, state, wparams, samples, int(sampleCount)) != 0)
+	{
+		return 10;
+	}
+
+	const char* decodedLanguage = whisper_lang_str(whisper_full_lang_id_from_state(state));
+	const whisper_token endOfText = whisper_token_eot(ctx);
+
+	/* whisper timestamps are in 10ms units */
+	const int segmentCount = whisper_full_n_segments_from_state(state);
+	for (int i = 0; i < segmentCount; i++)
+	{
+		TranscriptSegment segment;
+		segment.StartTime = timeOffset + double(whisper_full_get_segment_t0_from_state(state, i)) / 100.0;
+		segment.EndTime = timeOffset + double(whisper_full_get_segment_t1_from_state(state, i)) / 100.0;
+		segment.Text = whisper_full_get_segment_text_from_state(state, i);
+		segment.Language = decodedLanguage != nullptr ? decodedLanguage : "";
+
+		/* a token that ends part way through a character gets joined with the ones after it, until the character is complete */
+		bool joinNext = false;
+
+		const int tokenCount = whisper_full_n_tokens_from_state(state, i);
+		for (int j = 0; j < tokenCount; j++)
+		{
+			whisper_token_data data = whisper_full_get_token_data_from_state(state, i, j);
+
+			/* timestamp, language and other control tokens all come after end of text */
+			if (data.id >= endOfText)
+			{
+				continue;
+			}
+
+			const char* text = whisper_full_get_token_text_from_state(ctx, state, i, j);
+
+			if (joinNext)
+			{
+				TranscriptToken& token = segment.Tokens.back();
+				token.EndTime = timeOffset + double(data.t1) / 100.0;
+				token.Text += text;
+				token.Probability *= data.p;
+			}
+			else
+			{
+				TranscriptToken token;
+				token.StartTime = timeOffset + double(data.t0) / 100.0;
+				token.EndTime = timeOffset + double(data.t1) / 100.0;
+				token.Text = text;
+				token.Probability = data.p;
+				segment.Tokens.push_back(token);
+			}
+
+			joinNext = EndsInPartialUtf8(segment.Tokens.back().Text);
+		}
+
+		segmentsOut.push_back(std::move(segment));
+	}
 
 	return 0;
 }
 
+/// <summary>
+/// times a few ways of splitting the threads between batches on a calibration clip, and picks the one that gets through the most audio.
+/// on machines with SMT (or more then one socket) using every thread is often slower then using fewer, so half the threads get tried as well.
+/// needs the shared context loaded
+/// </summary>
+/// <param name="samples">- calibration clip (WHISPER_SAMPLE_RATE)</param>
+/// <param name="sampleCount">- amount of samples</param>
+/// <param name="language">- language of the audio</param>
+/// <param name="threadCount">- threads available</param>
+/// <param name="profile">- decoding profile the audio will be transcribed with</param>
+/// <returns>fastest configuration</returns>
+ThreadConfiguration TuneThreads(const float* samples, const size_t& sampleCount, const std::string& language, const int& threadCount = std::thread::hardware_concurrency(),
+	const DecodingProfile& profile = DecodingProfiles[DefaultDecodingProfile])
+{
+	std::vector<ThreadConfiguration> candidates;
+	for (int totalThreads : { std::max(threadCount, 1), std::max(threadCount / 2, 1) })
+	{
+		for (size_t slots = 1; slots <= TuningMaxSlots && int(slots) <= totalThreads; slots *= 2)
+		{
+			ThreadConfiguration candidate{ slots, totalThreads / int(slots) };
+
+			if (std::none_of(candidates.begin(), candidates.end(), [&](const ThreadConfiguration& other) { return other.JobSlots == candidate.JobSlots && other.ThreadsPerJob == candidate.ThreadsPerJob; }))
+			{
+				candidates.push_back(candidate);
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+		printf("Tuning threads on %.1f sec of audio (%zu configurations)\n", double(sampleCount) / WHISPER_SAMPLE_RATE, candidates.size());
+	}
+
+	ThreadConfiguration best = candidates.front();
+	double bestSpeed = 0.0;
+
+	for (const ThreadConfiguration& candidate : candidates)
+	{
+		WhisperStatePool states(ctx, candidate.JobSlots);
+		if (states.size() != candidate.JobSlots)
+		{
+			continue;
+		}
+
+		/* every slot transcribes the clip at the same time, like batches of different files would */
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::thread> jobs;
+		for (size_t i = 0; i < candidate.JobSlots; i++)
+		{
+			jobs.emplace_back([&]()
+				{
+					whisper_state* state = states.Acquire();
+					std::vector<TranscriptSegment> segments;
+					TranscribeWithState(state, samples, sampleCount, language, candidate.ThreadsPerJob, segments, 0.0, profile);
+					states.Release(state);
+				});
+		}
+		for (std::thread& job : jobs)
+		{
+			job.join();
+		}
+		auto stop = std::chrono::high_resolution_clock::now();
+
+		/* seconds of audio transcribed per second */
+		double speed = double(candidate.JobSlots * sampleCount) / WHISPER_SAMPLE_RATE / std::chrono::duration<double>(stop - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+			printf("%zu batches at once, %d threads each: %.2fx real time\n", candidate.JobSlots, candidate.ThreadsPerJob, speed);
+		}
+
+		if (speed > bestSpeed)
+		{
+			best = candidate;
+			bestSpeed = speed;
+		}
+	}
+
+	return best;
+}
+
+/// <summary>
+/// a piece of audio waiting to be transcribed
+/// </summary>
+struct TranscriptionJob
+{
+	std::string Name;								/* printed in front of its segments */
+	ArrayWrapper<float> Audio;						/* taken over by the scheduler (and deleted once it is queued), unless OwnsAudio is false */
+	std::optional<std::vector<AudioSpan>> Spans;	/* active parts of the audio, only those get transcribed (whole audio if not set) */
+	bool OwnsAudio = true;
+	std::function<void(std::vector<TranscriptSegment>&)> Done;	/* gets the merged segments once the whole job is done (on a worker thread) */
+};
+
+/// <summary>
+/// runs transcriptions on a pool of whisper states sharing the one model, each with its own worker thread.
+/// every job gets split into batches (see BatchSpans), and the batches of all queued jobs get spread over the states,
+/// so both many files and single long files make use of every state. the threads get split between the states,
+/// once every batch of a job is done its segments get merged back into one time ordered transcript
+/// </summary>
+class TranscriptionScheduler
+{
+public:
+	/// <summary>
+	/// starts the workers, the first one to run waits for the model (PreloadWhisperContext or loading it there) and creates the states,
+	/// so creating the scheduler doesn't hold up the DSP
+	/// </summary>
+	/// <param name="modelPath">- path to model used for transcribing</param>
+	/// <param name="profile">- how to decode</param>
+	/// <param name="jobSlots">- amount of batches running at the same time, 0 uses what was tuned for this host, model and profile (tunes on the first queued audio if nothing was yet)</param>
+	/// <param name="threadCount">- total amount of threads, split between the slots</param>
+	/// <param name="language">- language of the audio</param>
+	/// <param name="memoryBudget">- bytes of queued audio (owned by jobs) before Submit() starts blocking</param>
+	TranscriptionScheduler(const std::string& modelPath, const DecodingProfile& profile = DecodingProfiles[DefaultDecodingProfile], size_t jobSlots = 0, const int& threadCount = std::thread::hardware_concurrency(), const std::string& language = "auto", const size_t& memoryBudget = DefaultTranscriptionMemoryBudget)
+	{
+		ModelPath = modelPath;
+		Profile = profile;
+		Language = language;
+		MemoryBudget = memoryBudget;
+
+		TotalThreads = threadCount;
+		size_t workerCount = jobSlots;
+
+		if (jobSlots == 0)
+		{
+			std::optional<ThreadConfiguration> saved = LoadThreadConfiguration(modelPath, profile.Name);
+
+			if (saved.has_value())
+			{
+				SlotCount = saved->JobSlots;
+				ThreadsPerJob = saved->ThreadsPerJob;
+				workerCount = SlotCount;
+			}
+			else
+			{
+				/* the slot count is only known after tuning, so start enough workers for any of them (the extra ones stop) */
+				Tuning = true;
+				SlotCount = PickJobSlots(threadCount);
+				ThreadsPerJob = std::max<int>(threadCount / int(SlotCount), 1);
+				workerCount = std::max(SlotCount, TuningMaxSlots);
+			}
+		}
+		else
+		{
+			SlotCount = jobSlots;
+			ThreadsPerJob = std::max<int>(threadCount / int(jobSlots), 1);
+		}
+
+		for (size_t i = 0; i < workerCount; i++)
+		{
+			Workers.emplace_back(&TranscriptionScheduler::WorkerLoop, this, i);
+		}
+	}
+
+	TranscriptionScheduler(const TranscriptionScheduler&) = delete;
+	TranscriptionScheduler& operator=(const TranscriptionScheduler&) = delete;
+
+	~TranscriptionScheduler()
+	{
+		Finish();
+	}
+
+	/// <summary>
+	/// splits a job into batches and queues them, the scheduler takes over the job.
+	/// owned audio gets converted to QueuedAudioStorage and the float array deleted, the batches are loaded back one at a time by the workers.
+	/// blocks while the audio already queued plus this job's would go over the memory budget (a job always gets in if nothing else is queued),
+	/// so producers can't run too far ahead of transcription
+	/// </summary>
+	void Submit(TranscriptionJob&& job)
+	{
+		size_t audioBytes = job.OwnsAudio ? job.Audio.size * SampleStorageSize(QueuedAudioStorage) : 0;
+
+		{
+			std::unique_lock<std::mutex> lock(QueueMutex);
+			BudgetFreed.wait(lock, [&] { return QueuedBytes == 0 || QueuedBytes + audioBytes <= MemoryBudget; });
+			QueuedBytes += audioBytes;
+		}
+
+		std::shared_ptr<JobProgress> progress = std::make_shared<JobProgress>();
+		progress->Job = std::move(job);
+		progress->AudioBytes = audioBytes;
+
+		TranscriptionJob& queued = progress->Job;
+		std::vector<AudioSpan> spans = queued.Spans.value_or(std::vector<AudioSpan>{ { 0, queued.Audio.size } });
+		progress->Batches = BatchSpans(queued.Audio.data, queued.Audio.size, spans, WHISPER_SAMPLE_RATE);
+		progress->Results.resize(progress->Batches.size());
+		progress->Remaining = progress->Batches.size();
+
+		if (progress->Batches.empty())
+		{
+			{
+				std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+				printf("%s: no transmissions to transcribe\n", queued.Name.c_str());
+			}
+			CompleteJob(*progress);
+			return;
+		}
+
+		if (queued.OwnsAudio)
+		{
+			progress->StoredAudio = CompactBuffer(queued.Audio, QueuedAudioStorage);
+			queued.Audio.Delete();
+			queued.Audio.data = nullptr;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+			printf("%s: transcribing %zu batches (%.1f of %.1f sec)\n", queued.Name.c_str(), progress->Batches.size(),
+				float(std::accumulate(progress->Batches.begin(), progress->Batches.end(), size_t(0), [](size_t sum, const AudioSpan& batch) { return sum + batch.End - batch.Start; })) / WHISPER_SAMPLE_RATE,
+				float(queued.Audio.size) / WHISPER_SAMPLE_RATE);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(QueueMutex);
+			for (size_t i = 0; i < progress->Batches.size(); i++)
+			{
+				Queue.push_back({ progress, i });
+			}
+		}
+		BatchReady.notify_all();
+	}
+
+	/// <summary>
+	/// waits for every queued job to finish and stops the workers
+	/// </summary>
+	void Finish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(QueueMutex);
+			Stopping = true;
+		}
+		BatchReady.notify_all();
+
+		for (std::thread& worker : Workers)
+		{
+			if (worker.joinable())
+			{
+				worker.join();
+			}
+		}
+
+		Pool.reset(); /* states go before the context gets freed */
+	}
+
+private:
+	/// <summary>
+	/// a job and the results of its batches so far
+	/// </summary>
+	struct JobProgress
+	{
+		TranscriptionJob Job;
+		CompactBuffer StoredAudio;								/* the job's audio while it is queued, if it owns it (Job.Audio is empty then) */
+		std::vector<AudioSpan> Batches;
+		std::vector<std::vector<TranscriptSegment>> Results;	/* one per batch */
+		size_t Remaining = 0;									/* batches not done yet, guarded by QueueMutex */
+		size_t AudioBytes = 0;									/* counted against the memory budget */
+		bool Started = false;									/* a batch has been picked up, guarded by QueueMutex */
+		std::chrono::high_resolution_clock::time_point Start;	/* when the first batch got picked up, so waiting for the model isn't counted */
+	};
+
+	struct QueuedBatch
+	{
+		std::shared_ptr<JobProgress> Progress;
+		size_t Batch = 0;
+	};
+
+	std::unique_ptr<WhisperStatePool> Pool;
+	std::once_flag PoolCreated;
+	std::vector<std::thread> Workers;
+	std::deque<QueuedBatch> Queue;
+	std::mutex QueueMutex;
+	std::condition_variable BatchReady;
+	std::condition_variable BudgetFreed;
+	size_t QueuedBytes = 0;
+	size_t MemoryBudget = DefaultTranscriptionMemoryBudget;
+	bool Stopping = false;
+
+	std::string ModelPath;
+	std::string Language;
+	DecodingProfile Profile;
+	int ThreadsPerJob = 1;
+	size_t SlotCount = 1;
+	int TotalThreads = 1;
+	bool Tuning = false;	/* no saved configuration for this host, model and profile, tuned before the pool gets created */
+
+	/// <summary>
+	/// copies part of a job's audio out as floats (out of StoredAudio if the job owns it)
+	/// </summary>
+	/// <param name="progress">- job</param>
+	/// <param name="start">- first sample</param>
+	/// <param name="count">- amount of samples</param>
+	/// <param name="samples">- floats out, resized to count and padded with silence up to TranscriptionMinBatchLength</param>
+	static void LoadAudio(const JobProgress& progress, const size_t& start, const size_t& count, std::vector<float>& samples)
+	{
+		samples.assign(std::max(count, size_t(TranscriptionMinBatchLength * WHISPER_SAMPLE_RATE)), 0.0f);
+
+		if (progress.Job.Audio.data != nullptr)
+		{
+			std::copy(progress.Job.Audio.data + start, progress.Job.Audio.data + start + count, samples.data());
+		}
+		else
+		{
+			progress.StoredAudio.Load(samples.data(), count, start);
+		}
+	}
+
+	/// <summary>
+	/// waits for the first job and tunes the threads on TuningClipLength of the audio queued by then (from as many batches as it takes),
+	/// the rest of the workers wait in CreatePool meanwhile. the result is saved, so it only happens on the first run with a model.
+	/// if less audio then that is queued, the timings would mostly be whisper's fixed cost per batch, so the defaults get used and nothing is saved
+	/// </summary>
+	void TuneOnQueuedAudio()
+	{
+		const size_t clipLength = size_t(TuningClipLength * WHISPER_SAMPLE_RATE);
+		std::vector<float> calibration;
+
+		{
+			std::unique_lock<std::mutex> lock(QueueMutex);
+			BatchReady.wait(lock, [this] { return !Queue.empty() || Stopping; });
+
+			if (Queue.empty())
+			{
+				return;
+			}
+
+			/* the batches stay in the queue (with their jobs holding the audio), nobody else takes from it until the pool exists.
+			   only the real audio of each batch gets used, not the silence LoadAudio pads short batches with */
+			std::vector<float> samples;
+			for (const QueuedBatch& queued : Queue)
+			{
+				if (calibration.size() >= clipLength)
+				{
+					break;
+				}
+
+				const AudioSpan& batch = queued.Progress->Batches[queued.Batch];
+				size_t count = std::min(batch.End - batch.Start, clipLength - calibration.size());
+				LoadAudio(*queued.Progress, batch.Start, count, samples);
+				calibration.insert(calibration.end(), samples.begin(), samples.begin() + count);
+			}
+		}
+
+		if (calibration.size() < clipLength)
+		{
+			std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+			printf("only %.1f sec of audio to tune the threads on (needs %.0f sec), using the defaults for this run\n", float(calibration.size()) / WHISPER_SAMPLE_RATE, TuningClipLength);
+			return;
+		}
+
+		ThreadConfiguration best = TuneThreads(calibration.data(), calibration.size(), Language, TotalThreads, Profile);
+		SaveThreadConfiguration(ModelPath, Profile.Name, best);
+
+		SlotCount = best.JobSlots;
+		ThreadsPerJob = best.ThreadsPerJob;
+	}
+
+	/// <summary>
+	/// waits for the model and creates the states (runs once, on whichever worker gets there first)
+	/// </summary>
+	void CreatePool()
+	{
+		if (!LoadWhisperContext(ModelPath))
+		{
+			Pool = std::make_unique<WhisperStatePool>(ctx, 0);
+			return;
+		}
+
+		if (Tuning)
+		{
+			TuneOnQueuedAudio();
+		}
+
+		Pool = std::make_unique<WhisperStatePool>(ctx, SlotCount);
+
+		if (Pool->size() != 0)
+		{
+			std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+			printf("transcribing up to %zu batches at once, %d threads each\n", Pool->size(), ThreadsPerJob);
+		}
+	}
+
+	void WorkerLoop(const size_t workerIndex)
+	{
+		std::call_once(PoolCreated, &TranscriptionScheduler::CreatePool, this);
+
+		/* without the model (or states) one worker still goes through the queue, so every job gets completed (with no segments) */
+		whisper_state* state = nullptr;
+		if (workerIndex < Pool->size())
+		{
+			state = Pool->Acquire();
+		}
+		else if (workerIndex != 0)
+		{
+			return;
+		}
+
+		std::vector<float> samples; /* the batch being transcribed, reused between batches */
+
+		while (true)
+		{
+			QueuedBatch queued;
+
+			{
+				std::unique_lock<std::mutex> lock(QueueMutex);
+				BatchReady.wait(lock, [this] { return !Queue.empty() || Stopping; });
+
+				if (Queue.empty())
+				{
+					break;
+				}
+
+				queued = std::move(Queue.front());
+				Queue.pop_front();
+			}
+
+			JobProgress& progress = *queued.Progress;
+			const AudioSpan& batch = progress.Batches[queued.Batch];
+
+			{
+				std::lock_guard<std::mutex> lock(QueueMutex);
+				if (!progress.Started)
+				{
+					progress.Started = true;
+					progress.Start = std::chrono::high_resolution_clock::now();
+				}
+			}
+
+			if (state != nullptr)
+			{
+				LoadAudio(progress, batch.Start, batch.End - batch.Start, samples);
+			}
+
+			if (state != nullptr && TranscribeWithState(state, samples.data(), samples.size(), Language, ThreadsPerJob,
+				progress.Results[queued.Batch], double(batch.Start) / WHISPER_SAMPLE_RATE, Profile) != 0)
+			{
+				std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+				fprintf(stderr, "%s: failed to process audio at %.1f sec\n", progress.Job.Name.c_str(), double(batch.Start) / WHISPER_SAMPLE_RATE);
+			}
+
+			bool lastBatch;
+			{
+				std::lock_guard<std::mutex> lock(QueueMutex);
+				lastBatch = (--progress.Remaining == 0);
+			}
+
+			if (lastBatch)
+			{
+				CompleteJob(progress);
+			}
+		}
+
+		if (state != nullptr)
+		{
+			Pool->Release(state);
+		}
+	}
+
+	/// <summary>
+	/// merges the batch results (rebased to the job's timeline already), prints them in order and hands them over
+	/// </summary>
+	void CompleteJob(JobProgress& progress)
+	{
+		std::vector<TranscriptSegment> segments;
+		for (std::vector<TranscriptSegment>& result : progress.Results)
+		{
+			segments.insert(segments.end(), std::make_move_iterator(result.begin()), std::make_move_iterator(result.end()));
+		}
+		std::stable_sort(segments.begin(), segments.end(), [](const TranscriptSegment& a, const TranscriptSegment& b) { return a.StartTime < b.StartTime; });
+
+		auto stop = std::chrono::high_resolution_clock::now();
+
+		if (!progress.Batches.empty())
+		{
+			std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+			printf("\n");
+			for (const TranscriptSegment& segment : segments)
+			{
+				printf("%s [%s --> %s]  %s\n", progress.Job.Name.c_str(), to_timestamp(int64_t(segment.StartTime * 100.0 + 0.5)).c_str(),
+					to_timestamp(int64_t(segment.EndTime * 100.0 + 0.5)).c_str(), segment.Text.c_str());
+			}
+			printf("%s: Audio Transcribing took: %lld milliseconds\n\n", progress.Job.Name.c_str(), std::chrono::duration_cast<std::chrono::milliseconds>(stop - progress.Start).count());
+			fflush(stdout);
+		}
+
+		if (progress.Job.Done)
+		{
+			progress.Job.Done(segments);
+		}
+
+		if (progress.Job.OwnsAudio)
+		{
+			progress.Job.Audio.Delete();
+			progress.Job.Audio = ArrayWrapper<float>();
+			progress.StoredAudio.Delete();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(QueueMutex);
+			QueuedBytes -= progress.AudioBytes;
+		}
+		BudgetFreed.notify_all();
+	}
+};
+
 /// <summary>
 /// Needs to get called at the end of the programs execution (when whisper isn't being used anymore)
 /// </summary>
 void FreeWhisperContext()
 {
+	std::lock_guard<std::mutex> lock(ContextMutex);
+
+	/* a background load that nobody waited for still has to finish before its context can be freed */
+	if (ContextLoading.valid())
+	{
+		whisper_free(ContextLoading.get());
+		ContextLoadingPath.clear();
+	}
+
 	whisper_free(ctx);
 
 	ctx = nullptr; /* set to nullptr, if for whatever reason above function gets called again */
 }
 
 
-std::string GetModel()
+/// <summary>
+/// models that can be downloaded from the whisper.cpp model repository (file is ggml-{name}.bin).
+/// .en models are english only (a bit more accurate on english, the smaller ones especially),
+/// q5_0, q5_1 and q8_0 are quantised (smaller and faster on CPU, slightly less accurate), not every size comes in every one
+/// </summary>
+inline const std::vector<std::vector<std::string>> ModelCatalogue =
 {
-	std::string input;
-	printf("\nPlease input either the path to a model\nOr choose one from here (if not already, will get automatically downloaded)\ntiny\nbase\nsmall\nmedium\nlarge\n[Default = medium]: ");
-	getline(std::cin, input);
+	{ "tiny", "tiny-q5_1", "tiny-q8_0", "tiny.en", "tiny.en-q5_1", "tiny.en-q8_0" },
+	{ "base", "base-q5_1", "base-q8_0", "base.en", "base.en-q5_1", "base.en-q8_0" },
+	{ "small", "small-q5_1", "small-q8_0", "small.en", "small.en-q5_1", "small.en-q8_0" },
+	{ "medium", "medium-q5_0", "medium-q8_0", "medium.en", "medium.en-q5_0", "medium.en-q8_0" },
+	{ "large", "large-v2", "large-v2-q5_0", "large-v2-q8_0" },
+};
 
-	if (input.empty())
+/// <summary>
+/// checks if a name is one of the downloadable models
+/// </summary>
+/// <param name="name">- model name</param>
+inline bool IsCatalogueModel(const std::string& name)
+{
+	for (const std::vector<std::string>& family : ModelCatalogue)
 	{
-		input = "medium";
+		if (std::find(family.begin(), family.end(), name) != family.end())
+		{
+			return true;
+		}
 	}
 
-	if (input == "tiny" || input == "base" || input == "small" || input == "medium" || input == "large")
+	return false;
+}
+
+/// <summary>
+/// file a catalogue model gets kept in
+/// </summary>
+/// <param name="name">- model name</param>
+inline std::string CatalogueModelFile(const std::string& name)
+{
+	return std::format("ggml-{}.bin", name);
+}
+
+/// <summary>
+/// turns a model name or path into a model file, catalogue models get downloaded if they aren't already
+/// </summary>
+/// <param name="input">- model name or path</param>
+/// <returns>path to the model file</returns>
+std::string ResolveModel(const std::string& input)
+{
+	if (IsCatalogueModel(input))
 	{
-		std::string outFileName = std::format("ggml-{}.bin", input);
+		std::string outFileName = CatalogueModelFile(input);
 
 		if (!std::filesystem::exists(outFileName))
 		{
@@ -164,4 +1127,27 @@ std::string GetModel()
 	}
 
 	return input;
-}
\ No newline at end of file
+}
+
+std::string GetModel()
+{
+	std::string input;
+	printf("\nPlease input either the path to a model\nOr choose one from here (if not already, will get automatically downloaded)\n");
+	for (const std::vector<std::string>& family : ModelCatalogue)
+	{
+		for (const std::string& name : family)
+		{
+			printf("%s ", name.c_str());
+		}
+		printf("\n");
+	}
+	printf("[Default = medium]: ");
+	getline(std::cin, input);
+
+	if (input.empty())
+	{
+		input = "medium";
+	}
+
+	return ResolveModel(input);
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+
+#include "Common.hpp"
+#include "WAV.hpp"
+#include "SampleStorage.hpp"
+
+/* Decimated baseband cache.
+   File layout (little endian):
+	0	"LVBB"
+	4	version
+	8	sample format (BasebandCacheFormatCF16)
+	12	sample rate
+	16	sample count
+	24	key (sampled hash and modification time of the IQ file + front end settings)
+	32	final carrier offset (double)
+	40	size of the source IQ file
+	48	length of the source path, the path follows the header
+	then blocks of BasebandCacheBlockSize samples (last one can be shorter): a float scale, then I/Q half float pairs */
+const char BasebandCacheDirectory[] = "BasebandCache";
+const uint32_t BasebandCacheVersion = 1;			/* bump when the front end changes, so old caches stop matching */
+const uint32_t BasebandCacheFormatCF16 = 2;		/* block scaled complex half float */
+const size_t BasebandCacheHeaderSize = 56;
+const size_t BasebandCacheBlockSize = 4096;
+
+/// <summary>
+/// FNV-1a hash
+/// </summary>
+/// <param name="data">- data to hash</param>
+/// <param name="size">- size of data</param>
+/// <param name="hash">- hash to continue from</param>
+/// <returns>hash</returns>
+inline uint64_t Fnv1a(const void* data, const size_t& size, uint64_t hash = 14695981039346656037ull)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+/// <summary>
+/// hashes a file by its size, its modification time and evenly spread chunks of it (including the first and last), so multi GB captures don't have to be read in full.
+/// the modification time catches a file that got overwritten with a different capture of the same length, which the chunks can miss
+/// </summary>
+/// <param name="filePath">- file to hash</param>
+/// <param name="chunkCount">- amount of chunks read</param>
+/// <param name="chunkSize">- size of each chunk</param>
+/// <returns>hash</returns>
+inline uint64_t HashFileSampled(const std::filesystem::path& filePath, const size_t& chunkCount = 16, const size_t& chunkSize = 1 << 16)
+{
+	uint64_t fileSize = std::filesystem::file_size(filePath);
+	uint64_t hash = Fnv1a(&fileSize, sizeof(fileSize));
+
+	std::error_code error;
+	int64_t modified = std::filesystem::last_write_time(filePath, error).time_since_epoch().count();
+	hash = Fnv1a(&modified, sizeof(modified), hash);
+
+	std::ifstream file(filePath, std::ios::binary);
+	std::vector<char> chunk(chunkSize);
+
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		uint64_t position = fileSize > chunkSize ? (fileSize - chunkSize) * i / std::max<size_t>(chunkCount - 1, 1) : 0;
+		file.seekg(position, std::ios::beg);
+		file.read(chunk.data(), chunkSize);
+		hash = Fnv1a(chunk.data(), size_t(file.gcount()), hash);
+		file.clear();
+	}
+
+	return hash;
+}
+
+/* the cache is little endian, swaps 16 bit values on big endian machines (swapping is its own inverse, so this goes both ways) */
+inline void SwapToLittleEndian(uint16_t* values, const size_t& count)
+{
+	if constexpr (std::endian::native == std::endian::big)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			values[i] = uint16_t((values[i] >> 8) | (values[i] << 8));
+		}
+	}
+}
+
+/// <summary>
+/// writes a baseband cache as the IQ gets decimated. it goes into a temporary file which only replaces the real one once Finish() is called,
+/// so an interrupted run never leaves a cut off cache behind
+/// </summary>
+class BasebandCacheWriter
+{
+public:
+	/// <summary>
+	/// starts a cache file
+	/// </summary>
+	/// <param name="filePath">- path of the cache</param>
+	/// <param name="key">- cache key</param>
+	/// <param name="sampleRate">- sample rate of the baseband</param>
+	/// <param name="source">- IQ file the baseband comes from</param>
+	BasebandCacheWriter(const std::filesystem::path& filePath, const uint64_t& key, const uint32_t& sampleRate, const std::string& source)
+	{
+		FilePath = filePath;
+		TempPath = filePath.string() + ".tmp";
+
+		std::error_code error;
+		std::filesystem::create_directories(filePath.parent_path(), error);
+
+		CacheStream.open(TempPath, std::ios::binary | std::ios::trunc);
+		if (!CacheStream.is_open())
+		{
+			printf("failed to open %s, not caching\n", TempPath.string().c_str());
+			return;
+		}
+
+		char header[BasebandCacheHeaderSize] = {};
+		memcpy(header, "LVBB", 4);
+		PutLittleEndian(header + 4, BasebandCacheVersion, 4);
+		PutLittleEndian(header + 8, BasebandCacheFormatCF16, 4);
+		PutLittleEndian(header + 12, sampleRate, 4);
+		PutLittleEndian(header + 24, key, 8);
+		PutLittleEndian(header + 40, std::filesystem::file_size(source), 8);
+		PutLittleEndian(header + 48, source.size(), 4);
+
+		CacheStream.write(header, sizeof(header));
+		CacheStream.write(source.data(), source.size());
+
+		Pending.reserve(BasebandCacheBlockSize);
+	}
+
+	BasebandCacheWriter(const BasebandCacheWriter&) = delete;
+	BasebandCacheWriter& operator=(const BasebandCacheWriter&) = delete;
+
+	~BasebandCacheWriter()
+	{
+		if (CacheStream.is_open())
+		{
+			CacheStream.close();
+			std::error_code error;
+			std::filesystem::remove(TempPath, error);
+		}
+	}
+
+	bool IsOpen()
+	{
+		return CacheStream.is_open();
+	}
+
+	/// <summary>
+	/// adds decimated samples
+	/// </summary>
+	void Write(const std::complex<float>* data, const size_t& count)
+	{
+		if (!IsOpen())
+		{
+			return;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			Pending.push_back(data[i]);
+
+			if (Pending.size() == BasebandCacheBlockSize)
+			{
+				WriteBlock();
+			}
+		}
+	}
+
+	/// <summary>
+	/// writes the last block, fills in the header and moves the cache into place
+	/// </summary>
+	/// <param name="carrierOffset">- carrier offset the front end ended up at</param>
+	void Finish(const double& carrierOffset)
+	{
+		if (!IsOpen())
+		{
+			return;
+		}
+
+		if (!Pending.empty())
+		{
+			WriteBlock();
+		}
+
+		char field[8];
+		PutLittleEndian(field, SampleCount, 8);
+		CacheStream.seekp(16);
+		CacheStream.write(field, 8);
+
+		PutLittleEndian(field, std::bit_cast<uint64_t>(carrierOffset), 8);
+		CacheStream.seekp(32);
+		CacheStream.write(field, 8);
+
+		bool written = CacheStream.good();
+		CacheStream.close();
+
+		std::error_code error;
+		if (written)
+		{
+			std::filesystem::remove(FilePath, error); /* rename doesn't replace existing files on every platform */
+			std::filesystem::rename(TempPath, FilePath, error);
+		}
+
+		if (!written || error)
+		{
+			printf("failed to write baseband cache %s\n", FilePath.string().c_str());
+			std::filesystem::remove(TempPath, error);
+		}
+	}
+
+private:
+	std::filesystem::path FilePath;
+	std::filesystem::path TempPath;
+	std::ofstream CacheStream;
+
+	std::vector<std::complex<float>> Pending;
+	std::vector<float> Scaled;
+	std::vector<uint16_t> Halves;
+	uint64_t SampleCount = 0;
+
+	void WriteBlock()
+	{
+		/* half floats keep the same relative precision at every level, which is what the FM discriminator needs (its phase comes from
+		   the ratio of I and Q, even in deep fades). each block gets scaled to its own peak, so it sits in the half's normal range */
+		float peak = 0.0f;
+		for (const std::complex<float>& sample : Pending)
+		{
+			peak = std::max({ peak, std::fabs(sample.real()), std::fabs(sample.imag()) });
+		}
+
+		float scale = peak > 0.0f ? peak : 1.0f;
+		float inverse = 1.0f / scale;
+
+		/* complex<float> is laid out as I/Q float pairs, so the block converts as one float array */
+		const float* samples = reinterpret_cast<const float*>(Pending.data());
+		size_t valueCount = Pending.size() * 2;
+
+		Scaled.resize(valueCount);
+		for (size_t i = 0; i < valueCount; i++)
+		{
+			Scaled[i] = samples[i] * inverse;
+		}
+
+		Halves.resize(valueCount);
+		f2h_array(Scaled.data(), Halves.data(), valueCount);
+		SwapToLittleEndian(Halves.data(), valueCount);
+
+		char scaleBytes[4];
+		PutLittleEndian(scaleBytes, std::bit_cast<uint32_t>(scale), 4);
+		CacheStream.write(scaleBytes, sizeof(scaleBytes));
+		CacheStream.write(reinterpret_cast<const char*>(Halves.data()), valueCount * sizeof(uint16_t));
+		SampleCount += Pending.size();
+		Pending.clear();
+	}
+};
+
+/// <summary>
+/// reads a baseband cache back, block by block
+/// </summary>
+class BasebandCacheReader
+{
+public:
+	/// <summary>
+	/// opens a cache, IsOpen() is only true if it exists and matches
+	/// </summary>
+	/// <param name="filePath">- path of the cache</param>
+	/// <param name="key">- expected cache key</param>
+	/// <param name="sampleRate">- expected sample rate</param>
+	BasebandCacheReader(const std::filesystem::path& filePath, const uint64_t& key, const uint32_t& sampleRate)
+	{
+		CacheStream.open(filePath, std::ios::binary);
+		if (!CacheStream.is_open())
+		{
+			return;
+		}
+
+		uint8_t header[BasebandCacheHeaderSize];
+		if (!CacheStream.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+			memcmp(header, "LVBB", 4) != 0 ||
+			GetLittleEndian(header + 4, 4) != BasebandCacheVersion ||
+			GetLittleEndian(header + 8, 4) != BasebandCacheFormatCF16 ||
+			GetLittleEndian(header + 12, 4) != sampleRate ||
+			GetLittleEndian(header + 24, 8) != key)
+		{
+			CacheStream.close();
+			return;
+		}
+
+		SampleCount = GetLittleEndian(header + 16, 8);
+		CarrierOffset = std::bit_cast<double>(GetLittleEndian(header + 32, 8));
+		CacheStream.seekg(BasebandCacheHeaderSize + GetLittleEndian(header + 48, 4), std::ios::beg);
+	}
+
+	bool IsOpen()
+	{
+		return CacheStream.is_open();
+	}
+
+	uint64_t GetSampleCount()
+	{
+		return SampleCount;
+	}
+
+	double GetCarrierOffset()
+	{
+		return CarrierOffset;
+	}
+
+	/// <summary>
+	/// reads the next block
+	/// </summary>
+	/// <param name="data">- out, has to fit BasebandCacheBlockSize samples</param>
+	/// <returns>amount of samples read, 0 at the end (or if the file is cut off)</returns>
+	size_t Read(std::complex<float>* data)
+	{
+		size_t count = size_t(std::min<uint64_t>(BasebandCacheBlockSize, SampleCount - ReadCount));
+		if (!IsOpen() || count == 0)
+		{
+			return 0;
+		}
+
+		size_t valueCount = count * 2;
+		uint8_t scaleBytes[4];
+		Halves.resize(valueCount);
+
+		if (!CacheStream.read(reinterpret_cast<char*>(scaleBytes), sizeof(scaleBytes)) ||
+			!CacheStream.read(reinterpret_cast<char*>(Halves.data()), valueCount * sizeof(uint16_t)))
+		{
+			return 0;
+		}
+
+		float scale = std::bit_cast<float>(uint32_t(GetLittleEndian(scaleBytes, 4)));
+		SwapToLittleEndian(Halves.data(), valueCount);
+
+		float* samples = reinterpret_cast<float*>(data);
+		h2f_array(Halves.data(), samples, valueCount);
+		for (size_t i = 0; i < valueCount; i++)
+		{
+			samples[i] *= scale;
+		}
+
+		ReadCount += count;
+		return count;
+	}
+
+private:
+	std::ifstream CacheStream;
+	std::vector<uint16_t> Halves;
+	uint64_t SampleCount = 0;
+	uint64_t ReadCount = 0;
+	double CarrierOffset = 0.0;
+};
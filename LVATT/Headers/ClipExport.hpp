@@ -0,0 +1,172 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#include "AudioTranscribing.hpp"
+
+/// <summary>
+/// escapes a string so it can go inside JSON quotes.
+/// bytes that aren't part of a whole UTF-8 character (a character cut off at the end of the text) become U+FFFD, so the JSON stays valid
+/// </summary>
+/// <param name="text">- text to escape</param>
+/// <returns>escaped text</returns>
+inline std::string JsonEscape(const std::string& text)
+{
+	std::string outString;
+	outString.reserve(text.size());
+
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		char character = text[i];
+
+		/* multi byte characters pass through whole, if every continuation byte is there */
+		size_t length = Utf8SequenceLength(static_cast<unsigned char>(character));
+		if (length != 1)
+		{
+			bool complete = length != 0 && i + length <= text.size();
+			for (size_t j = 1; complete && j < length; j++)
+			{
+				complete = (static_cast<unsigned char>(text[i + j]) & 0xC0) == 0x80;
+			}
+
+			if (complete)
+			{
+				outString.append(text, i, length);
+				i += length - 1;
+			}
+			else
+			{
+				outString += "\\ufffd";
+			}
+			continue;
+		}
+
+		switch (character)
+		{
+		case '"': outString += "\\\""; break;
+		case '\\': outString += "\\\\"; break;
+		case '\n': outString += "\\n"; break;
+		case '\r': outString += "\\r"; break;
+		case '\t': outString += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(character) < 0x20)
+			{
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", character);
+				outString += buffer;
+			}
+			else
+			{
+				outString += character;
+			}
+		}
+	}
+
+	return outString;
+}
+
+/// <summary>
+/// one exported transmission
+/// </summary>
+struct ClipRecord
+{
+	std::string Clip;				/* clip file name, relative to the index */
+	std::string Source;				/* IQ (or WAV) file the clip came from */
+	uint64_t SourceOffset = 0;		/* first sample of the clip in the source file */
+	uint64_t SourceCount = 0;		/* samples of the source file the clip covers */
+	double StartTime = 0.0;			/* seconds from the start of the source file */
+	double EndTime = 0.0;
+	std::string Transcript;
+};
+
+/// <summary>
+/// JSONL index of exported clips, one line per clip.
+/// every line gets flushed as soon as its clip is written, so an interrupted export still leaves a usable index,
+/// and review tools can jump straight to SourceOffset in the source file
+/// </summary>
+class ClipIndexWriter
+{
+public:
+	/// <summary>
+	/// creates (or replaces) the index
+	/// </summary>
+	/// <param name="filePath">- path to the index</param>
+	ClipIndexWriter(const std::filesystem::path& filePath)
+	{
+		IndexStream.open(filePath, std::ios::binary | std::ios::trunc);
+
+		if (!IndexStream.is_open())
+		{
+			printf("failed to open %s\n", filePath.string().c_str());
+		}
+	}
+
+	bool IsOpen()
+	{
+		return IndexStream.is_open();
+	}
+
+	/// <summary>
+	/// adds a clip to the index
+	/// </summary>
+	/// <param name="record">- clip</param>
+	void Append(const ClipRecord& record)
+	{
+		if (!IsOpen())
+		{
+			return;
+		}
+
+		char numbers[160];
+		snprintf(numbers, sizeof(numbers), "\"source_offset\":%llu,\"source_count\":%llu,\"start\":%.3f,\"end\":%.3f",
+			(unsigned long long)record.SourceOffset, (unsigned long long)record.SourceCount, record.StartTime, record.EndTime);
+
+		IndexStream << "{\"clip\":\"" << JsonEscape(record.Clip) << "\",\"source\":\"" << JsonEscape(record.Source) << "\"," << numbers
+			<< ",\"transcript\":\"" << JsonEscape(record.Transcript) << "\"}\n";
+		IndexStream.flush();
+	}
+
+private:
+	std::ofstream IndexStream;
+};
+
+/// <summary>
+/// joins the text of every segment whose middle is inside a time span
+/// </summary>
+/// <param name="segments">- transcribed segments</param>
+/// <param name="startTime">- span start (seconds)</param>
+/// <param name="endTime">- span end (seconds)</param>
+/// <returns>joined text</returns>
+inline std::string CollectTranscript(const std::vector<TranscriptSegment>& segments, const double& startTime, const double& endTime)
+{
+	std::string text;
+
+	for (const TranscriptSegment& segment : segments)
+	{
+		double middle = (segment.StartTime + segment.EndTime) / 2.0;
+		if (middle < startTime || middle >= endTime)
+		{
+			continue;
+		}
+
+		/* whisper starts segments with a space */
+		size_t first = segment.Text.find_first_not_of(' ');
+		if (first == std::string::npos)
+		{
+			continue;
+		}
+
+		if (!text.empty())
+		{
+			text += ' ';
+		}
+		text += segment.Text.substr(first);
+	}
+
+	return text;
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include <ctype.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
 
 template<class type>
 struct ArrayWrapper
@@ -26,4 +29,44 @@ struct ArrayWrapper
 	{
 		return data[pos];
 	}
-};
\ No newline at end of file
+};
+
+/// <summary>
+/// part of an audio array [Start, End), in samples
+/// </summary>
+struct AudioSpan
+{
+	size_t Start = 0;
+	size_t End = 0;
+};
+
+/// <summary>
+/// splits count items into contiguous ranges and runs function(begin, end) on each range in its own thread
+/// </summary>
+/// <param name="count">- amount of items</param>
+/// <param name="function">- function which takes in (begin, end)</param>
+/// <param name="threadCount">- max amount of threads to use</param>
+template<class Function>
+void ParallelFor(const size_t& count, Function function, size_t threadCount = std::thread::hardware_concurrency())
+{
+	threadCount = std::max<size_t>(std::min(threadCount, count), 1);
+
+	if (threadCount == 1)
+	{
+		function(size_t(0), count);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	size_t chunkSize = (count + threadCount - 1) / threadCount;
+
+	for (size_t begin = 0; begin < count; begin += chunkSize)
+	{
+		threads.emplace_back(function, begin, std::min(begin + chunkSize, count));
+	}
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <numbers>
+#include <utility>
+#include <stdexcept>
+
+/// <summary>
+/// Radix 2 complex FFT.
+/// works on split real/imaginary arrays with twiddles stored per stage, so every butterfly loop is a plain loop over contiguous floats (which the compiler turns into SIMD)
+/// </summary>
+class FFT
+{
+public:
+	/// <summary>
+	/// creates FFT of a set size
+	/// </summary>
+	/// <param name="size">- FFT size, has to be a power of 2</param>
+	FFT(const size_t& size)
+	{
+		if (size < 2 || (size & (size - 1)) != 0)
+		{
+			throw std::invalid_argument("FFT size has to be a power of 2");
+		}
+
+		Size = size;
+
+		/* bit reversal table */
+		size_t bits = 0;
+		while ((size_t(1) << bits) < Size)
+		{
+			bits++;
+		}
+
+		BitReverse.resize(Size);
+		for (size_t i = 0; i < Size; i++)
+		{
+			size_t reversed = 0;
+			for (size_t bit = 0; bit < bits; bit++)
+			{
+				reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+			}
+			BitReverse[i] = reversed;
+		}
+
+		/* twiddles for the stage with butterfly span "half" are stored at [half-1, 2*half-1) */
+		TwiddleReal.resize(Size - 1);
+		TwiddleImag.resize(Size - 1);
+		for (size_t half = 1; half < Size; half <<= 1)
+		{
+			for (size_t j = 0; j < half; j++)
+			{
+				double angle = -std::numbers::pi * double(j) / double(half);
+				TwiddleReal[half - 1 + j] = float(std::cos(angle));
+				TwiddleImag[half - 1 + j] = float(std::sin(angle));
+			}
+		}
+	}
+
+	size_t GetSize()
+	{
+		return Size;
+	}
+
+	/// <summary>
+	/// forward transform in place
+	/// </summary>
+	/// <param name="real">- real part, Size long</param>
+	/// <param name="imag">- imaginary part, Size long</param>
+	void Forward(float* real, float* imag)
+	{
+		Transform(real, imag);
+	}
+
+	/// <summary>
+	/// inverse transform in place (scaled by 1/Size, so Forward then Inverse gives back the input)
+	/// </summary>
+	/// <param name="real">- real part, Size long</param>
+	/// <param name="imag">- imaginary part, Size long</param>
+	void Inverse(float* real, float* imag)
+	{
+		/* inverse FFT is a forward FFT with real and imaginary swapped */
+		Transform(imag, real);
+
+		float scale = 1.0f / float(Size);
+		for (size_t i = 0; i < Size; i++)
+		{
+			real[i] *= scale;
+			imag[i] *= scale;
+		}
+	}
+
+private:
+	size_t Size;
+	std::vector<size_t> BitReverse;
+	std::vector<float> TwiddleReal;
+	std::vector<float> TwiddleImag;
+
+	void Transform(float* real, float* imag)
+	{
+		for (size_t i = 0; i < Size; i++)
+		{
+			size_t j = BitReverse[i];
+			if (i < j)
+			{
+				std::swap(real[i], real[j]);
+				std::swap(imag[i], imag[j]);
+			}
+		}
+
+		for (size_t half = 1; half < Size; half <<= 1)
+		{
+			const float* twiddleReal = TwiddleReal.data() + half - 1;
+			const float* twiddleImag = TwiddleImag.data() + half - 1;
+
+			for (size_t start = 0; start < Size; start += 2 * half)
+			{
+				float* aReal = real + start;
+				float* aImag = imag + start;
+				float* bReal = aReal + half;
+				float* bImag = aImag + half;
+
+				for (size_t j = 0; j < half; j++)
+				{
+					float tReal = bReal[j] * twiddleReal[j] - bImag[j] * twiddleImag[j];
+					float tImag = bReal[j] * twiddleImag[j] + bImag[j] * twiddleReal[j];
+
+					bReal[j] = aReal[j] - tReal;
+					bImag[j] = aImag[j] - tImag;
+					aReal[j] += tReal;
+					aImag[j] += tImag;
+				}
+			}
+		}
+	}
+};
+
+/// <summary>
+/// creates a periodic Hann window
+/// </summary>
+/// <param name="size">- window size</param>
+/// <returns>window</returns>
+inline std::vector<float> HannWindow(const size_t& size)
+{
+	std::vector<float> window(size);
+
+	for (size_t i = 0; i < size; i++)
+	{
+		window[i] = float(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * double(i) / double(size)));
+	}
+
+	return window;
+}
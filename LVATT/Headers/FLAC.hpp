@@ -0,0 +1,757 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Common.hpp"
+#include "WAV.hpp"
+
+/* Encoder settings */
+const size_t FlacBlockSize = 4096;			/* samples per channel in each frame */
+const uint32_t FlacBitsPerSample = 16;
+const uint32_t FlacMaxFixedOrder = 4;
+const uint32_t FlacMaxLpcOrder = 12;
+const uint32_t FlacLpcPrecision = 14;		/* bits per quantised LPC coefficient */
+const uint32_t FlacMaxPartitionOrder = 8;
+const uint32_t FlacMaxRiceParameter = 14;	/* 15 is the escape code */
+const size_t FlacFramesPerBatch = 256;		/* frames encoded in parallel before being written, keeps memory use flat on long files */
+
+/* CRC-8 (x^8 + x^2 + x + 1) for frame headers and CRC-16 (x^16 + x^15 + x^2 + 1) for whole frames */
+constexpr std::array<uint8_t, 256> MakeFlacCrc8Table()
+{
+	std::array<uint8_t, 256> table{};
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+		}
+		table[i] = uint8_t(crc);
+	}
+	return table;
+}
+
+constexpr std::array<uint16_t, 256> MakeFlacCrc16Table()
+{
+	std::array<uint16_t, 256> table{};
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i << 8;
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x8005) : (crc << 1);
+		}
+		table[i] = uint16_t(crc);
+	}
+	return table;
+}
+
+inline constexpr std::array<uint8_t, 256> FlacCrc8Table = MakeFlacCrc8Table();
+inline constexpr std::array<uint16_t, 256> FlacCrc16Table = MakeFlacCrc16Table();
+
+inline uint8_t FlacCrc8(const uint8_t* data, const size_t& size)
+{
+	uint8_t crc = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = FlacCrc8Table[crc ^ data[i]];
+	}
+	return crc;
+}
+
+inline uint16_t FlacCrc16(const uint8_t* data, const size_t& size)
+{
+	uint16_t crc = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = uint16_t((crc << 8) ^ FlacCrc16Table[(crc >> 8) ^ data[i]]);
+	}
+	return crc;
+}
+
+/// <summary>
+/// big endian (MSB first) bit writer, like the FLAC bitstream needs
+/// </summary>
+class FlacBitWriter
+{
+public:
+	std::vector<uint8_t> Bytes;
+
+	/// <summary>
+	/// writes the lowest bits of a value
+	/// </summary>
+	/// <param name="value">- value to write</param>
+	/// <param name="bits">- amount of bits (up to 32)</param>
+	void Write(const uint32_t& value, const uint32_t& bits)
+	{
+		if (bits == 0)
+		{
+			return;
+		}
+
+		Accumulator = (Accumulator << bits) | (value & (0xFFFFFFFFu >> (32 - bits)));
+		BitCount += bits;
+
+		while (BitCount >= 8)
+		{
+			BitCount -= 8;
+			Bytes.push_back(uint8_t(Accumulator >> BitCount));
+		}
+	}
+
+	void WriteSigned(const int32_t& value, const uint32_t& bits)
+	{
+		Write(uint32_t(value), bits);
+	}
+
+	/// <summary>
+	/// writes "zeros" 0 bits, followed by a 1 bit
+	/// </summary>
+	void WriteUnary(uint32_t zeros)
+	{
+		while (zeros >= 32)
+		{
+			Write(0, 32);
+			zeros -= 32;
+		}
+		Write(1, zeros + 1);
+	}
+
+	/// <summary>
+	/// writes a signed value as a rice code (zigzag folded, quotient in unary, then the remainder)
+	/// </summary>
+	void WriteRice(const int32_t& value, const uint32_t& parameter)
+	{
+		uint32_t folded = (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+		WriteUnary(folded >> parameter);
+		Write(folded, parameter);
+	}
+
+	/// <summary>
+	/// writes a number with the UTF-8 style coding FLAC uses for frame numbers
+	/// </summary>
+	void WriteUtf8(const uint64_t& value)
+	{
+		if (value < 0x80)
+		{
+			Write(uint32_t(value), 8);
+			return;
+		}
+
+		/* amount of continuation bytes (6 bits each), the first byte holds the rest */
+		uint32_t extraBytes = 1;
+		while (extraBytes < 6 && value >= (uint64_t(1) << (6 * extraBytes + 6 - extraBytes)))
+		{
+			extraBytes++;
+		}
+
+		uint32_t firstByte = (0xFF00u >> (extraBytes + 1)) & 0xFF;
+		Write(firstByte | uint32_t(value >> (6 * extraBytes)), 8);
+
+		for (uint32_t i = extraBytes; i > 0; i--)
+		{
+			Write(0x80 | uint32_t((value >> (6 * (i - 1))) & 0x3F), 8);
+		}
+	}
+
+	/// <summary>
+	/// pads with 0 bits up to the next byte
+	/// </summary>
+	void AlignToByte()
+	{
+		if (BitCount != 0)
+		{
+			Write(0, 8 - BitCount);
+		}
+	}
+
+private:
+	uint64_t Accumulator = 0;
+	uint32_t BitCount = 0;
+};
+
+/// <summary>
+/// chosen rice coding for a residual
+/// </summary>
+struct FlacRicePlan
+{
+	uint32_t PartitionOrder = 0;
+	std::vector<uint32_t> Parameters;
+	uint64_t Bits = UINT64_MAX;
+};
+
+/// <summary>
+/// finds the partition order and rice parameters which take the least bits for a residual
+/// </summary>
+/// <param name="residual">- residual, starts at the sample after the warm up</param>
+/// <param name="blockSize">- samples in the whole subframe</param>
+/// <param name="order">- predictor order (amount of warm up samples)</param>
+/// <returns>rice plan</returns>
+inline FlacRicePlan PlanRice(const int32_t* residual, const size_t& blockSize, const uint32_t& order)
+{
+	/* highest usable partition order, partitions need to split the block evenly and have more samples then the warm up */
+	uint32_t maxPartitionOrder = 0;
+	while (maxPartitionOrder < FlacMaxPartitionOrder && (blockSize % (size_t(1) << (maxPartitionOrder + 1))) == 0 && (blockSize >> (maxPartitionOrder + 1)) > order)
+	{
+		maxPartitionOrder++;
+	}
+
+	/* folded residual sums at the finest partitions, coarser orders are just merged from those */
+	size_t partitionCount = size_t(1) << maxPartitionOrder;
+	size_t partitionSize = blockSize >> maxPartitionOrder;
+	std::vector<uint64_t> sums(partitionCount, 0);
+
+	size_t residualIndex = 0;
+	for (size_t partition = 0; partition < partitionCount; partition++)
+	{
+		size_t count = partitionSize - (partition == 0 ? order : 0);
+		uint64_t sum = 0;
+		for (size_t i = 0; i < count; i++, residualIndex++)
+		{
+			sum += (uint32_t(residual[residualIndex]) << 1) ^ uint32_t(residual[residualIndex] >> 31);
+		}
+		sums[partition] = sum;
+	}
+
+	FlacRicePlan best;
+
+	for (uint32_t partitionOrder = maxPartitionOrder + 1; partitionOrder-- > 0;)
+	{
+		size_t currentCount = size_t(1) << partitionOrder;
+		size_t currentSize = blockSize >> partitionOrder;
+
+		FlacRicePlan plan;
+		plan.PartitionOrder = partitionOrder;
+		plan.Parameters.resize(currentCount);
+		plan.Bits = 2 + 4; /* coding method and partition order */
+
+		for (size_t partition = 0; partition < currentCount; partition++)
+		{
+			uint64_t count = currentSize - (partition == 0 ? order : 0);
+
+			/* estimate: every sample takes parameter + 1 bits, plus its quotient */
+			uint64_t bestBits = UINT64_MAX;
+			for (uint32_t parameter = 0; parameter <= FlacMaxRiceParameter; parameter++)
+			{
+				uint64_t bits = count * (parameter + 1) + (sums[partition] >> parameter);
+				if (bits < bestBits)
+				{
+					bestBits = bits;
+					plan.Parameters[partition] = parameter;
+				}
+			}
+
+			plan.Bits += 4 + bestBits;
+		}
+
+		if (plan.Bits < best.Bits)
+		{
+			best = std::move(plan);
+		}
+
+		/* merge partition pairs for the next coarser order */
+		for (size_t partition = 0; partition < currentCount / 2; partition++)
+		{
+			sums[partition] = sums[partition * 2] + sums[partition * 2 + 1];
+		}
+	}
+
+	return best;
+}
+
+/// <summary>
+/// writes a residual with a rice plan
+/// </summary>
+inline void WriteResidual(FlacBitWriter& writer, const int32_t* residual, const size_t& blockSize, const uint32_t& order, const FlacRicePlan& plan)
+{
+	writer.Write(0, 2); /* rice with 4 bit parameters */
+	writer.Write(plan.PartitionOrder, 4);
+
+	size_t partitionSize = blockSize >> plan.PartitionOrder;
+	size_t residualIndex = 0;
+
+	for (size_t partition = 0; partition < plan.Parameters.size(); partition++)
+	{
+		uint32_t parameter = plan.Parameters[partition];
+		writer.Write(parameter, 4);
+
+		size_t count = partitionSize - (partition == 0 ? order : 0);
+		for (size_t i = 0; i < count; i++, residualIndex++)
+		{
+			writer.WriteRice(residual[residualIndex], parameter);
+		}
+	}
+}
+
+/// <summary>
+/// residual of one of the fixed polynomial predictors (order 0 to 4)
+/// </summary>
+inline void FixedResidual(const int32_t* samples, const size_t& count, const uint32_t& order, int32_t* residual)
+{
+	for (size_t i = order; i < count; i++)
+	{
+		const int32_t* x = samples + i;
+		switch (order)
+		{
+		case 0: residual[i] = x[0]; break;
+		case 1: residual[i - 1] = x[0] - x[-1]; break;
+		case 2: residual[i - 2] = x[0] - 2 * x[-1] + x[-2]; break;
+		case 3: residual[i - 3] = x[0] - 3 * x[-1] + 3 * x[-2] - x[-3]; break;
+		case 4: residual[i - 4] = x[0] - 4 * x[-1] + 6 * x[-2] - 4 * x[-3] + x[-4]; break;
+		}
+	}
+}
+
+/// <summary>
+/// LPC coefficients for every order up to maxOrder (Levinson-Durbin on a windowed autocorrelation)
+/// </summary>
+/// <param name="samples">- samples</param>
+/// <param name="count">- amount of samples</param>
+/// <param name="maxOrder">- highest order</param>
+/// <param name="coefficients">- out, [order - 1] holds the coefficients for that order</param>
+/// <param name="errors">- out, [order - 1] holds the prediction error for that order</param>
+/// <returns>false if the signal is silent</returns>
+inline bool ComputeLpc(const int32_t* samples, const size_t& count, const uint32_t& maxOrder, std::vector<std::vector<double>>& coefficients, std::vector<double>& errors)
+{
+	/* Welch window, keeps the block edges from looking like transients */
+	std::vector<double> windowed(count);
+	double half = double(count - 1) / 2.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double x = (double(i) - half) / (half + 1.0);
+		windowed[i] = double(samples[i]) * (1.0 - x * x);
+	}
+
+	std::vector<double> autocorrelation(maxOrder + 1, 0.0);
+	for (uint32_t lag = 0; lag <= maxOrder; lag++)
+	{
+		double sum = 0.0;
+		for (size_t i = lag; i < count; i++)
+		{
+			sum += windowed[i] * windowed[i - lag];
+		}
+		autocorrelation[lag] = sum;
+	}
+
+	if (autocorrelation[0] == 0.0)
+	{
+		return false;
+	}
+
+	coefficients.assign(maxOrder, {});
+	errors.assign(maxOrder, 0.0);
+
+	std::vector<double> lpc(maxOrder, 0.0);
+	std::vector<double> previous(maxOrder, 0.0);
+	double error = autocorrelation[0];
+
+	for (uint32_t order = 0; order < maxOrder; order++)
+	{
+		double reflection = -autocorrelation[order + 1];
+		for (uint32_t j = 0; j < order; j++)
+		{
+			reflection -= lpc[j] * autocorrelation[order - j];
+		}
+		reflection /= error;
+
+		previous = lpc;
+		lpc[order] = reflection;
+		for (uint32_t j = 0; j < order; j++)
+		{
+			lpc[j] = previous[j] + reflection * previous[order - 1 - j];
+		}
+
+		error *= (1.0 - reflection * reflection);
+
+		/* FLAC predicts with +sum(coefficient * past sample), the recursion above gives the negated ones */
+		coefficients[order].resize(order + 1);
+		for (uint32_t j = 0; j <= order; j++)
+		{
+			coefficients[order][j] = -lpc[j];
+		}
+		errors[order] = std::max(error, 0.0);
+	}
+
+	return true;
+}
+
+/// <summary>
+/// quantises LPC coefficients to a set precision
+/// </summary>
+/// <param name="coefficients">- coefficients</param>
+/// <param name="quantised">- out, quantised coefficients</param>
+/// <param name="shift">- out, right shift applied to the prediction</param>
+/// <returns>false if they can't be quantised</returns>
+inline bool QuantiseLpc(const std::vector<double>& coefficients, std::vector<int32_t>& quantised, int32_t& shift)
+{
+	double maxCoefficient = 0.0;
+	for (double coefficient : coefficients)
+	{
+		maxCoefficient = std::max(maxCoefficient, std::fabs(coefficient));
+	}
+
+	if (maxCoefficient <= 0.0)
+	{
+		return false;
+	}
+
+	int exponent;
+	std::frexp(maxCoefficient, &exponent);
+	shift = std::clamp(int32_t(FlacLpcPrecision) - 1 - exponent, 0, 15);
+
+	const int32_t maxValue = (1 << (FlacLpcPrecision - 1)) - 1;
+	const int32_t minValue = -(1 << (FlacLpcPrecision - 1));
+
+	/* error feedback, so rounding errors don't pile up over the coefficients */
+	quantised.resize(coefficients.size());
+	double carry = 0.0;
+	for (size_t i = 0; i < coefficients.size(); i++)
+	{
+		carry += coefficients[i] * double(1 << shift);
+		int32_t value = int32_t(std::lround(carry));
+		quantised[i] = std::clamp(value, minValue, maxValue);
+		carry -= double(quantised[i]);
+	}
+
+	return true;
+}
+
+/// <summary>
+/// residual of a quantised LPC predictor
+/// </summary>
+inline void LpcResidual(const int32_t* samples, const size_t& count, const std::vector<int32_t>& quantised, const int32_t& shift, int32_t* residual)
+{
+	size_t order = quantised.size();
+	for (size_t i = order; i < count; i++)
+	{
+		int64_t sum = 0;
+		for (size_t j = 0; j < order; j++)
+		{
+			sum += int64_t(quantised[j]) * samples[i - 1 - j];
+		}
+		residual[i - order] = samples[i] - int32_t(sum >> shift);
+	}
+}
+
+/// <summary>
+/// encodes one channel of a frame, picking the smallest of constant, verbatim, fixed and LPC subframes
+/// </summary>
+/// <param name="writer">- frame bit writer</param>
+/// <param name="samples">- channel samples</param>
+/// <param name="count">- amount of samples</param>
+inline void EncodeFlacSubframe(FlacBitWriter& writer, const int32_t* samples, const size_t& count)
+{
+	/* constant */
+	if (std::all_of(samples, samples + count, [&](int32_t sample) { return sample == samples[0]; }))
+	{
+		writer.Write(0, 1);
+		writer.Write(0b000000, 6);
+		writer.Write(0, 1);
+		writer.WriteSigned(samples[0], FlacBitsPerSample);
+		return;
+	}
+
+	uint64_t verbatimBits = uint64_t(count) * FlacBitsPerSample;
+
+	std::vector<int32_t> residual(count);
+	std::vector<int32_t> bestResidual;
+	FlacRicePlan bestPlan;
+	uint64_t bestBits = verbatimBits;
+	int bestType = -1; /* -1 verbatim, 0 fixed, 1 LPC */
+	uint32_t bestOrder = 0;
+
+	/* fixed predictors */
+	for (uint32_t order = 0; order <= FlacMaxFixedOrder && order < count; order++)
+	{
+		FixedResidual(samples, count, order, residual.data());
+		FlacRicePlan plan = PlanRice(residual.data(), count, order);
+		uint64_t bits = uint64_t(order) * FlacBitsPerSample + plan.Bits;
+
+		if (bits < bestBits)
+		{
+			bestBits = bits;
+			bestType = 0;
+			bestOrder = order;
+			bestPlan = std::move(plan);
+			bestResidual.assign(residual.begin(), residual.begin() + (count - order));
+		}
+	}
+
+	/* LPC, only the order with the lowest expected size gets tried (from the Levinson-Durbin prediction errors) */
+	uint32_t maxLpcOrder = uint32_t(std::min<size_t>(FlacMaxLpcOrder, count - 1));
+	std::vector<std::vector<double>> coefficients;
+	std::vector<double> errors;
+	std::vector<int32_t> quantised;
+	int32_t shift = 0;
+
+	if (maxLpcOrder > 0 && ComputeLpc(samples, count, maxLpcOrder, coefficients, errors))
+	{
+		uint32_t lpcOrder = 1;
+		double bestEstimate = 1e300;
+		for (uint32_t order = 1; order <= maxLpcOrder; order++)
+		{
+			double bitsPerSample = std::max(0.5 * std::log2(0.5 * errors[order - 1] / double(count) + 1e-30), 0.0);
+			double estimate = bitsPerSample * double(count - order) + double(order) * (FlacBitsPerSample + FlacLpcPrecision);
+			if (estimate < bestEstimate)
+			{
+				bestEstimate = estimate;
+				lpcOrder = order;
+			}
+		}
+
+		if (QuantiseLpc(coefficients[lpcOrder - 1], quantised, shift))
+		{
+			LpcResidual(samples, count, quantised, shift, residual.data());
+			FlacRicePlan plan = PlanRice(residual.data(), count, lpcOrder);
+			uint64_t bits = uint64_t(lpcOrder) * (FlacBitsPerSample + FlacLpcPrecision) + 4 + 5 + plan.Bits;
+
+			if (bits < bestBits)
+			{
+				bestBits = bits;
+				bestType = 1;
+				bestOrder = lpcOrder;
+				bestPlan = std::move(plan);
+				bestResidual.assign(residual.begin(), residual.begin() + (count - lpcOrder));
+			}
+		}
+	}
+
+	writer.Write(0, 1); /* zero padding bit */
+
+	if (bestType == -1)
+	{
+		writer.Write(0b000001, 6);
+		writer.Write(0, 1); /* no wasted bits */
+		for (size_t i = 0; i < count; i++)
+		{
+			writer.WriteSigned(samples[i], FlacBitsPerSample);
+		}
+		return;
+	}
+
+	if (bestType == 0)
+	{
+		writer.Write(0b001000 | bestOrder, 6);
+		writer.Write(0, 1);
+	}
+	else
+	{
+		writer.Write(0b100000 | (bestOrder - 1), 6);
+		writer.Write(0, 1);
+	}
+
+	/* warm up samples */
+	for (uint32_t i = 0; i < bestOrder; i++)
+	{
+		writer.WriteSigned(samples[i], FlacBitsPerSample);
+	}
+
+	if (bestType == 1)
+	{
+		writer.Write(FlacLpcPrecision - 1, 4);
+		writer.WriteSigned(shift, 5);
+		for (int32_t coefficient : quantised)
+		{
+			writer.WriteSigned(coefficient, FlacLpcPrecision);
+		}
+	}
+
+	WriteResidual(writer, bestResidual.data(), count, bestOrder, bestPlan);
+}
+
+/// <summary>
+/// FLAC's sample rate code for a frame header (0 = take it from STREAMINFO)
+/// </summary>
+inline uint32_t FlacSampleRateCode(const uint32_t& sampleRate)
+{
+	switch (sampleRate)
+	{
+	case 8000: return 4;
+	case 16000: return 5;
+	case 22050: return 6;
+	case 24000: return 7;
+	case 32000: return 8;
+	case 44100: return 9;
+	case 48000: return 10;
+	case 96000: return 11;
+	default: return 0;
+	}
+}
+
+/// <summary>
+/// encodes one whole frame
+/// </summary>
+/// <param name="data">- interleaved 16 bit audio for this frame</param>
+/// <param name="frameSamples">- samples per channel in this frame</param>
+/// <param name="channels">- channel count</param>
+/// <param name="sampleRate">- sample rate</param>
+/// <param name="frameNumber">- index of the frame</param>
+/// <returns>encoded frame</returns>
+inline std::vector<uint8_t> EncodeFlacFrame(const int16_t* data, const size_t& frameSamples, const uint8_t& channels, const uint32_t& sampleRate, const uint64_t& frameNumber)
+{
+	std::vector<int32_t> channelSamples(frameSamples);
+
+	FlacBitWriter writer;
+	writer.Bytes.reserve(frameSamples * channels * sizeof(int16_t) + 32);
+
+	/* header */
+	writer.Write(0b11111111111110, 14);		/* sync code */
+	writer.Write(0, 1);
+	writer.Write(0, 1);						/* fixed block size */
+	writer.Write(frameSamples == FlacBlockSize ? 12 : 7, 4); /* 12 = 4096, 7 = size stored after the frame number */
+	writer.Write(FlacSampleRateCode(sampleRate), 4);
+	writer.Write(channels - 1, 4);			/* independent channels */
+	writer.Write(0b100, 3);					/* 16 bits per sample */
+	writer.Write(0, 1);
+	writer.WriteUtf8(frameNumber);
+	if (frameSamples != FlacBlockSize)
+	{
+		writer.Write(uint32_t(frameSamples - 1), 16);
+	}
+	writer.Write(FlacCrc8(writer.Bytes.data(), writer.Bytes.size()), 8);
+
+	for (uint8_t channel = 0; channel < channels; channel++)
+	{
+		for (size_t i = 0; i < frameSamples; i++)
+		{
+			channelSamples[i] = data[i * channels + channel];
+		}
+
+		EncodeFlacSubframe(writer, channelSamples.data(), frameSamples);
+	}
+
+	writer.AlignToByte();
+	uint16_t crc = FlacCrc16(writer.Bytes.data(), writer.Bytes.size());
+	writer.Write(crc, 16);
+
+	return std::move(writer.Bytes);
+}
+
+/// <summary>
+/// writes the STREAMINFO block (after the "fLaC" marker)
+/// </summary>
+inline void WriteFlacStreamInfo(std::ofstream& flacStream, const uint32_t& blockSize, const uint32_t& minFrameSize, const uint32_t& maxFrameSize, const uint32_t& sampleRate, const uint8_t& channels, const uint64_t& totalSamples)
+{
+	FlacBitWriter writer;
+
+	writer.Write(1, 1);		/* last metadata block */
+	writer.Write(0, 7);		/* STREAMINFO */
+	writer.Write(34, 24);	/* length */
+
+	writer.Write(blockSize, 16);
+	writer.Write(blockSize, 16);
+	writer.Write(minFrameSize, 24);
+	writer.Write(maxFrameSize, 24);
+	writer.Write(sampleRate, 20);
+	writer.Write(channels - 1, 3);
+	writer.Write(FlacBitsPerSample - 1, 5);
+	writer.Write(uint32_t(totalSamples >> 32), 4);
+	writer.Write(uint32_t(totalSamples), 32);
+
+	/* MD5 of the audio, all 0 means it wasn't calculated */
+	for (int i = 0; i < 16; i++)
+	{
+		writer.Write(0, 8);
+	}
+
+	flacStream.write(reinterpret_cast<const char*>(writer.Bytes.data()), writer.Bytes.size());
+}
+
+/// <summary>
+/// Writes audio into a 16 bit FLAC file (no external library).
+/// frames are independent, so batches of them get encoded in parallel and then written in order.
+/// each channel picks the smallest of constant, verbatim, fixed (order 0-4) and LPC (order picked from the prediction error) subframes,
+/// with the residual rice coded over the partition order that takes the least bits
+/// </summary>
+/// <param name="filePath">- path to the FLAC file</param>
+/// <param name="data">- interleaved 16 bit audio</param>
+/// <param name="dataSize">- amount of samples (all channels)</param>
+/// <param name="channels">- channel count (1 to 8)</param>
+/// <param name="sampleRate">- sample rate</param>
+void WriteFlac(const std::filesystem::path& filePath, const int16_t* data, const size_t& dataSize, const uint8_t& channels, const uint32_t& sampleRate)
+{
+	if (channels == 0 || channels > 8)
+	{
+		throw std::invalid_argument("FLAC supports 1 to 8 channels");
+	}
+
+	if (dataSize % channels != 0)
+	{
+		throw std::invalid_argument("channels don't fit into data size (maybe the wrong channel count was picked)");
+	}
+
+	std::ofstream flacStream(filePath, std::ios::binary | std::ios::trunc);
+
+	if (!flacStream.is_open())
+	{
+		printf("failed to open %s\n", filePath.string().c_str());
+		return;
+	}
+
+	uint64_t totalSamples = dataSize / channels;
+	uint32_t blockSize = uint32_t(std::clamp<uint64_t>(totalSamples, 16, FlacBlockSize));
+	size_t frameCount = size_t((totalSamples + FlacBlockSize - 1) / FlacBlockSize);
+
+	/* STREAMINFO gets written again at the end, once the frame sizes are known */
+	flacStream.write("fLaC", 4);
+	WriteFlacStreamInfo(flacStream, blockSize, 0, 0, sampleRate, channels, totalSamples);
+
+	uint32_t minFrameSize = UINT32_MAX;
+	uint32_t maxFrameSize = 0;
+	std::vector<std::vector<uint8_t>> frames(std::min(FlacFramesPerBatch, frameCount));
+
+	for (size_t batchStart = 0; batchStart < frameCount; batchStart += FlacFramesPerBatch)
+	{
+		size_t batchCount = std::min(FlacFramesPerBatch, frameCount - batchStart);
+
+		ParallelFor(batchCount, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					size_t frame = batchStart + i;
+					size_t firstSample = frame * FlacBlockSize;
+					size_t frameSamples = size_t(std::min<uint64_t>(FlacBlockSize, totalSamples - firstSample));
+					frames[i] = EncodeFlacFrame(data + firstSample * channels, frameSamples, channels, sampleRate, frame);
+				}
+			});
+
+		for (size_t i = 0; i < batchCount; i++)
+		{
+			flacStream.write(reinterpret_cast<const char*>(frames[i].data()), frames[i].size());
+			minFrameSize = std::min(minFrameSize, uint32_t(frames[i].size()));
+			maxFrameSize = std::max(maxFrameSize, uint32_t(frames[i].size()));
+		}
+	}
+
+	if (frameCount == 0)
+	{
+		minFrameSize = 0;
+	}
+
+	flacStream.seekp(4);
+	WriteFlacStreamInfo(flacStream, blockSize, minFrameSize, maxFrameSize, sampleRate, channels, totalSamples);
+	flacStream.close();
+}
+
+/// <summary>
+/// Writes float audio into a 16 bit FLAC file (same 16 bit conversion as the WAV writer)
+/// </summary>
+/// <param name="filePath">- path to the FLAC file</param>
+/// <param name="data">- interleaved audio (-1 to 1)</param>
+/// <param name="dataSize">- amount of samples (all channels)</param>
+/// <param name="channels">- channel count (1 to 8)</param>
+/// <param name="sampleRate">- sample rate</param>
+void WriteFlac(const std::filesystem::path& filePath, const float* data, const size_t& dataSize, const uint8_t& channels, const uint32_t& sampleRate)
+{
+	std::vector<int16_t> samples(dataSize);
+	f2s_array(data, samples.data(), dataSize, 1);
+
+	WriteFlac(filePath, samples.data(), dataSize, channels, sampleRate);
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/// <summary>
+/// Read only memory mapped file. the pages come straight from the OS page cache, so there is no read buffer and no copy,
+/// and other processes mapping the same file share the same physical memory
+/// </summary>
+class MappedFile
+{
+public:
+	/// <summary>
+	/// maps the whole file, check IsOpen() to see if it worked
+	/// </summary>
+	/// <param name="filePath">- path to the file</param>
+	MappedFile(const std::filesystem::path& filePath)
+	{
+#ifdef _WIN32
+		FileHandle = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (FileHandle == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(FileHandle, &fileSize))
+		{
+			return;
+		}
+		MappedSize = size_t(fileSize.QuadPart);
+		Opened = true;
+
+		if (MappedSize == 0)
+		{
+			return;
+		}
+
+		MappingHandle = CreateFileMappingW(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (MappingHandle == nullptr)
+		{
+			Opened = false;
+			return;
+		}
+
+		MappedData = static_cast<const uint8_t*>(MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+		Opened = MappedData != nullptr;
+#else
+		FileDescriptor = open(filePath.c_str(), O_RDONLY);
+		if (FileDescriptor < 0)
+		{
+			return;
+		}
+
+		struct stat fileStat;
+		if (fstat(FileDescriptor, &fileStat) != 0)
+		{
+			return;
+		}
+		MappedSize = size_t(fileStat.st_size);
+		Opened = true;
+
+		if (MappedSize == 0)
+		{
+			return;
+		}
+
+		void* mapping = mmap(nullptr, MappedSize, PROT_READ, MAP_SHARED, FileDescriptor, 0);
+		if (mapping == MAP_FAILED)
+		{
+			Opened = false;
+			return;
+		}
+
+		MappedData = static_cast<const uint8_t*>(mapping);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (MappedData != nullptr)
+		{
+			UnmapViewOfFile(MappedData);
+		}
+		if (MappingHandle != nullptr)
+		{
+			CloseHandle(MappingHandle);
+		}
+		if (FileHandle != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(FileHandle);
+		}
+#else
+		if (MappedData != nullptr)
+		{
+			munmap(const_cast<uint8_t*>(MappedData), MappedSize);
+		}
+		if (FileDescriptor >= 0)
+		{
+			close(FileDescriptor);
+		}
+#endif
+	}
+
+	bool IsOpen()
+	{
+		return Opened;
+	}
+
+	const uint8_t* Data()
+	{
+		return MappedData;
+	}
+
+	size_t Size()
+	{
+		return MappedSize;
+	}
+
+	/// <summary>
+	/// tells the OS the file will be read from start to end, so it reads ahead more
+	/// </summary>
+	void AdviseSequential()
+	{
+#ifndef _WIN32
+		if (MappedData != nullptr)
+		{
+			madvise(const_cast<uint8_t*>(MappedData), MappedSize, MADV_SEQUENTIAL);
+		}
+#endif
+	}
+
+private:
+	const uint8_t* MappedData = nullptr;
+	size_t MappedSize = 0;
+	bool Opened = false;
+
+#ifdef _WIN32
+	HANDLE FileHandle = INVALID_HANDLE_VALUE;
+	HANDLE MappingHandle = nullptr;
+#else
+	int FileDescriptor = -1;
+#endif
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cctype>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "AudioTranscribing.hpp"
+
+const double MemorySampleInterval = 0.01; /* seconds between resident memory samples while a model runs */
+
+/// <summary>
+/// splits text into words for scoring, lower case with the punctuation taken out (apostrophes stay, so "don't" is one word)
+/// </summary>
+/// <param name="text">- text</param>
+/// <returns>words</returns>
+inline std::vector<std::string> NormaliseWords(const std::string& text)
+{
+	std::vector<std::string> words;
+	std::string word;
+
+	for (char character : text)
+	{
+		unsigned char byte = static_cast<unsigned char>(character);
+
+		/* UTF-8 bytes are kept as is, so non english text still splits on spaces */
+		if (std::isalnum(byte) || byte == '\'' || byte >= 0x80)
+		{
+			word += char(std::tolower(byte));
+		}
+		else if (!word.empty())
+		{
+			words.push_back(word);
+			word.clear();
+		}
+	}
+
+	if (!word.empty())
+	{
+		words.push_back(word);
+	}
+
+	return words;
+}
+
+/// <summary>
+/// word error rate, (substitutions + deletions + insertions) / reference words, from the word level edit distance
+/// </summary>
+/// <param name="reference">- reference words</param>
+/// <param name="hypothesis">- transcribed words</param>
+/// <returns>word error rate (can go over 1 if a lot got inserted)</returns>
+inline double WordErrorRate(const std::vector<std::string>& reference, const std::vector<std::string>& hypothesis)
+{
+	if (reference.empty())
+	{
+		return hypothesis.empty() ? 0.0 : 1.0;
+	}
+
+	/* one row of the edit distance table at a time */
+	std::vector<size_t> previous(hypothesis.size() + 1);
+	std::vector<size_t> current(hypothesis.size() + 1);
+
+	for (size_t j = 0; j <= hypothesis.size(); j++)
+	{
+		previous[j] = j;
+	}
+
+	for (size_t i = 1; i <= reference.size(); i++)
+	{
+		current[0] = i;
+
+		for (size_t j = 1; j <= hypothesis.size(); j++)
+		{
+			size_t substitution = previous[j - 1] + (reference[i - 1] == hypothesis[j - 1] ? 0 : 1);
+			current[j] = std::min({ substitution, previous[j] + 1, current[j - 1] + 1 });
+		}
+
+		std::swap(previous, current);
+	}
+
+	return double(previous[hypothesis.size()]) / double(reference.size());
+}
+
+/// <summary>
+/// resident memory of this process
+/// </summary>
+/// <returns>bytes, 0 if it can't be read on this platform</returns>
+inline size_t GetResidentMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.WorkingSetSize;
+	}
+	return 0;
+#else
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm == nullptr)
+	{
+		return 0;
+	}
+
+	unsigned long long totalPages = 0, residentPages = 0;
+	int readCount = fscanf(statm, "%llu %llu", &totalPages, &residentPages);
+	fclose(statm);
+
+	return readCount == 2 ? size_t(residentPages) * size_t(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
+
+/// <summary>
+/// keeps sampling the resident memory on a thread, to get the peak over a stretch of work.
+/// the OS peak counters only ever go up, so they can't tell one model apart from the one before it
+/// </summary>
+class PeakMemorySampler
+{
+public:
+	PeakMemorySampler()
+	{
+		Peak = GetResidentMemory();
+		Worker = std::thread(&PeakMemorySampler::SampleLoop, this);
+	}
+
+	PeakMemorySampler(const PeakMemorySampler&) = delete;
+	PeakMemorySampler& operator=(const PeakMemorySampler&) = delete;
+
+	~PeakMemorySampler()
+	{
+		Stop();
+	}
+
+	/// <summary>
+	/// stops sampling
+	/// </summary>
+	/// <returns>highest resident memory seen (bytes)</returns>
+	size_t Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(SampleMutex);
+			Stopping = true;
+		}
+		StopSignal.notify_one();
+
+		if (Worker.joinable())
+		{
+			Worker.join();
+		}
+
+		return std::max(Peak, GetResidentMemory());
+	}
+
+private:
+	std::thread Worker;
+	std::mutex SampleMutex;
+	std::condition_variable StopSignal;
+	size_t Peak = 0;
+	bool Stopping = false;
+
+	void SampleLoop()
+	{
+		std::unique_lock<std::mutex> lock(SampleMutex);
+
+		while (!StopSignal.wait_for(lock, std::chrono::duration<double>(MemorySampleInterval), [this] { return Stopping; }))
+		{
+			Peak = std::max(Peak, GetResidentMemory());
+		}
+	}
+};
+
+/// <summary>
+/// how one model did on the reference clip, with one decoding profile
+/// </summary>
+struct ModelBenchmark
+{
+	std::string Model;
+	std::string Profile;
+	bool Loaded = false;
+	double LoadTime = 0.0;			/* seconds */
+	double RealTimeFactor = 0.0;	/* transcription time / clip length, under 1 is faster then real time */
+	size_t PeakMemory = 0;			/* bytes, resident memory of the process while the clip was transcribed (loaded model included) */
+	double WordErrorRate = 0.0;
+};
+
+/// <summary>
+/// loads a model, transcribes the reference clip with it once per decoding profile and frees it again.
+/// the clip goes in as one piece (whisper walks through it in 30 second windows itself)
+/// </summary>
+/// <param name="modelPath">- path to the model</param>
+/// <param name="audio">- reference clip, 16KHz mono</param>
+/// <param name="referenceWords">- reference transcript (see NormaliseWords)</param>
+/// <param name="profiles">- decoding profiles to compare</param>
+/// <param name="language">- language of the clip</param>
+/// <param name="threadCount">- threads whisper gets</param>
+/// <returns>results, one per profile</returns>
+std::vector<ModelBenchmark> BenchmarkModel(const std::string& modelPath, const ArrayWrapper<float>& audio, const std::vector<std::string>& referenceWords, const std::vector<DecodingProfile>& profiles,
+	const std::string& language = "auto", const int& threadCount = std::thread::hardware_concurrency())
+{
+	std::vector<ModelBenchmark> results;
+
+	auto loadStart = std::chrono::high_resolution_clock::now();
+	bool loaded = LoadWhisperContext(modelPath);
+	auto loadStop = std::chrono::high_resolution_clock::now();
+
+	for (const DecodingProfile& profile : profiles)
+	{
+		ModelBenchmark& result = results.emplace_back();
+		result.Model = modelPath;
+		result.Profile = profile.Name;
+
+		if (!loaded)
+		{
+			continue;
+		}
+
+		PeakMemorySampler memory;
+
+		whisper_state* state = whisper_init_state(ctx);
+		if (state == nullptr)
+		{
+			continue;
+		}
+
+		std::vector<TranscriptSegment> segments;
+
+		auto transcribeStart = std::chrono::high_resolution_clock::now();
+		int transcribeResult = TranscribeWithState(state, audio.data, audio.size, language, threadCount, segments, 0.0, profile);
+		auto transcribeStop = std::chrono::high_resolution_clock::now();
+
+		whisper_free_state(state);
+		result.PeakMemory = memory.Stop();
+
+		if (transcribeResult != 0)
+		{
+			fprintf(stderr, "%s (%s): failed to process audio\n", modelPath.c_str(), profile.Name.c_str());
+			continue;
+		}
+
+		std::string transcript;
+		for (const TranscriptSegment& segment : segments)
+		{
+			transcript += segment.Text + " ";
+		}
+
+		result.Loaded = true;
+		result.LoadTime = std::chrono::duration<double>(loadStop - loadStart).count();
+		result.RealTimeFactor = std::chrono::duration<double>(transcribeStop - transcribeStart).count() / (double(audio.size) / WHISPER_SAMPLE_RATE);
+		result.WordErrorRate = WordErrorRate(referenceWords, NormaliseWords(transcript));
+	}
+
+	FreeWhisperContext();
+	return results;
+}
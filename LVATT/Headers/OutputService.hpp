@@ -0,0 +1,273 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <exception>
+#include <cstdio>
+#include <vector>
+#include <filesystem>
+
+#include "WAV.hpp"
+
+const size_t DefaultOutputQueueSize = 8; /* tasks waiting to be written before Submit() starts blocking, bounds the memory held by pending audio */
+
+/// <summary>
+/// a piece of output work (a file write, an index line...). move only, so whatever buffers it holds get handed over instead of copied
+/// </summary>
+class OutputTask
+{
+public:
+	template<class Function> requires (!std::is_same_v<std::decay_t<Function>, OutputTask>)
+	OutputTask(Function&& function)
+		: Callable(std::make_unique<Holder<std::decay_t<Function>>>(std::forward<Function>(function))) {}
+
+	OutputTask() {}
+
+	OutputTask(OutputTask&&) = default;
+	OutputTask& operator=(OutputTask&&) = default;
+
+	OutputTask(const OutputTask&) = delete;
+	OutputTask& operator=(const OutputTask&) = delete;
+
+	void operator()()
+	{
+		if (Callable)
+		{
+			Callable->Run();
+		}
+	}
+
+private:
+	struct Base
+	{
+		virtual ~Base() {}
+		virtual void Run() = 0;
+	};
+
+	template<class Function>
+	struct Holder : Base
+	{
+		Function Stored;
+
+		template<class Argument>
+		Holder(Argument&& function) : Stored(std::forward<Argument>(function)) {}
+
+		void Run() override
+		{
+			Stored();
+		}
+	};
+
+	std::unique_ptr<Base> Callable;
+};
+
+/// <summary>
+/// runs output tasks on one dedicated writer thread, so file writes overlap with demodulation and transcription.
+/// the writer thread is the only one touching the files, tasks run in the order they were submitted.
+/// the queue is bounded, if the disk falls behind Submit() blocks instead of letting pending audio pile up in memory
+/// </summary>
+class OutputService
+{
+public:
+	/// <summary>
+	/// starts the writer thread
+	/// </summary>
+	/// <param name="maxQueued">- max amount of tasks waiting to run</param>
+	OutputService(const size_t& maxQueued = DefaultOutputQueueSize)
+	{
+		MaxQueued = std::max<size_t>(maxQueued, 1);
+		Worker = std::thread(&OutputService::WorkerLoop, this);
+	}
+
+	OutputService(const OutputService&) = delete;
+	OutputService& operator=(const OutputService&) = delete;
+
+	~OutputService()
+	{
+		Finish();
+	}
+
+	/// <summary>
+	/// queues a task, blocks while the queue is full
+	/// </summary>
+	/// <param name="task">- task to run on the writer thread</param>
+	void Submit(OutputTask&& task)
+	{
+		std::unique_lock<std::mutex> lock(QueueMutex);
+		SpaceFree.wait(lock, [this] { return Queue.size() < MaxQueued; });
+
+		Queue.push_back(std::move(task));
+		TaskReady.notify_one();
+	}
+
+	/// <summary>
+	/// waits for every queued task to be written and stops the writer thread
+	/// </summary>
+	void Finish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(QueueMutex);
+			Stopping = true;
+		}
+		TaskReady.notify_one();
+
+		if (Worker.joinable())
+		{
+			Worker.join();
+		}
+	}
+
+private:
+	std::thread Worker;
+	std::deque<OutputTask> Queue;
+	std::mutex QueueMutex;
+	std::condition_variable TaskReady;
+	std::condition_variable SpaceFree;
+	size_t MaxQueued = DefaultOutputQueueSize;
+	bool Stopping = false;
+
+	void WorkerLoop()
+	{
+		while (true)
+		{
+			OutputTask task;
+
+			{
+				std::unique_lock<std::mutex> lock(QueueMutex);
+				TaskReady.wait(lock, [this] { return !Queue.empty() || Stopping; });
+
+				/* only stops once everything submitted has been written */
+				if (Queue.empty())
+				{
+					return;
+				}
+
+				task = std::move(Queue.front());
+				Queue.pop_front();
+			}
+			SpaceFree.notify_one();
+
+			/* a failed write shouldn't take the rest of the output down with it */
+			try
+			{
+				task();
+			}
+			catch (const std::exception& exception)
+			{
+				fprintf(stderr, "output task failed: %s\n", exception.what());
+			}
+		}
+	}
+};
+
+/// <summary>
+/// WAV file written on the output thread while the audio is still being made, block by block as it comes in.
+/// blocks get converted to 16 bit and queued WavWriteBlockSize samples at a time, so only the queue's worth waits in memory,
+/// and the file grows (with the header patched every so often, see WavWriter) while the DSP is still running
+/// </summary>
+class WavOutputStream
+{
+public:
+	/// <summary>
+	/// queues creating the file
+	/// </summary>
+	/// <param name="output">- output service the file gets written with, has to outlive the stream</param>
+	/// <param name="filePath">- path to the WAV file</param>
+	/// <param name="channels">- channel count</param>
+	/// <param name="sampleRate">- sample rate</param>
+	WavOutputStream(OutputService& output, const std::filesystem::path& filePath, const uint16_t& channels, const uint32_t& sampleRate)
+		: Output(output), Writer(std::make_shared<std::unique_ptr<WavWriter>>())
+	{
+		Output.Submit([writer = Writer, filePath, channels, sampleRate]()
+			{
+				*writer = std::make_unique<WavWriter>(filePath, channels, sampleRate);
+
+				if (!(*writer)->IsOpen())
+				{
+					printf("failed to open %s\n", filePath.string().c_str());
+				}
+			});
+	}
+
+	WavOutputStream(const WavOutputStream&) = delete;
+	WavOutputStream& operator=(const WavOutputStream&) = delete;
+
+	~WavOutputStream()
+	{
+		Close();
+	}
+
+	/// <summary>
+	/// appends audio (interleaved if more then 1 channel), blocks while the output queue is full
+	/// </summary>
+	/// <param name="data">- audio</param>
+	/// <param name="count">- amount of samples</param>
+	void Write(const float* data, const size_t& count)
+	{
+		for (size_t offset = 0; offset < count;)
+		{
+			size_t blockCount = std::min(WavWriteBlockSize - Pending.size(), count - offset);
+			size_t start = Pending.size();
+
+			Pending.resize(start + blockCount);
+			f2s_array(data + offset, Pending.data() + start, blockCount, 1);
+			offset += blockCount;
+
+			if (Pending.size() == WavWriteBlockSize)
+			{
+				SubmitPending();
+			}
+		}
+	}
+
+	/// <summary>
+	/// queues the rest of the audio and closing the file (the header gets its final sizes then)
+	/// </summary>
+	void Close()
+	{
+		if (Closed)
+		{
+			return;
+		}
+		Closed = true;
+
+		SubmitPending();
+		Output.Submit([writer = Writer]()
+			{
+				if (*writer)
+				{
+					(*writer)->Close();
+				}
+			});
+	}
+
+private:
+	OutputService& Output;
+	std::shared_ptr<std::unique_ptr<WavWriter>> Writer;	/* created on the output thread, like every other file */
+	std::vector<int16_t> Pending;						/* converted samples not queued yet */
+	bool Closed = false;
+
+	void SubmitPending()
+	{
+		if (Pending.empty())
+		{
+			return;
+		}
+
+		Output.Submit([writer = Writer, block = std::move(Pending)]()
+			{
+				if (*writer)
+				{
+					(*writer)->Write(block.data(), block.size());
+				}
+			});
+
+		Pending = std::vector<int16_t>();
+	}
+};
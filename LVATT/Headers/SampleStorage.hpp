@@ -0,0 +1,368 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <bit>
+#include <vector>
+#include <algorithm>
+
+#include "Common.hpp"
+#include "WAV.hpp"
+
+/* SIMD conversion paths (scalar fallbacks are always there). AVX-512 is picked at compile time (LVATT_NATIVE_ARCH),
+   F16C gets built into every x86 build and checked for at run time, so default builds use it as well */
+#if defined(__AVX512F__)
+#define LVATT_AVX512
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define LVATT_F16C
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define LVATT_F16C_TARGET	/* MSVC allows the intrinsics without /arch */
+#else
+#define LVATT_F16C_TARGET __attribute__((target("avx,f16c")))
+#endif
+#elif defined(LVATT_AVX512)
+#include <immintrin.h>
+#endif
+
+/// <summary>
+/// float to IEEE half (round to nearest even, overflow goes to infinity)
+/// </summary>
+/// <param name="value">- float</param>
+/// <returns>half bits</returns>
+inline uint16_t FloatToHalf(const float& value)
+{
+	uint32_t bits = std::bit_cast<uint32_t>(value);
+	uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	/* infinity and NaN */
+	if (magnitude >= 0x7F800000)
+	{
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+	}
+
+	/* rounds to above 65504 */
+	if (magnitude >= 0x477FF000)
+	{
+		return sign | 0x7C00;
+	}
+
+	/* below 2^-14, subnormal half (counted in 2^-24 steps) */
+	if (magnitude < 0x38800000)
+	{
+		return sign | uint16_t(lrintf(std::bit_cast<float>(magnitude) * 16777216.0f));
+	}
+
+	/* normal, rebias the exponent (127 to 15) and round the 13 dropped mantissa bits */
+	uint32_t rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+	return sign | uint16_t((rounded - 0x38000000) >> 13);
+}
+
+/// <summary>
+/// IEEE half to float (exact)
+/// </summary>
+/// <param name="value">- half bits</param>
+/// <returns>float</returns>
+inline float HalfToFloat(const uint16_t& value)
+{
+	uint32_t sign = uint32_t(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+
+	if (exponent == 0)
+	{
+		float subnormal = float(mantissa) * (1.0f / 16777216.0f);
+		return sign != 0 ? -subnormal : subnormal;
+	}
+
+	if (exponent == 31)
+	{
+		return std::bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+	}
+
+	return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+#ifdef LVATT_F16C
+/// <summary>
+/// if the CPU (and OS) can run F16C, checked once. every x86-64 CPU since about 2012 can
+/// </summary>
+inline bool HasF16C()
+{
+#if defined(__F16C__)
+	return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+	static const bool supported = []()
+		{
+			/* F16C, AVX and OSXSAVE bits, then the OS has to be saving the AVX registers */
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 29)) != 0 && (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		}();
+	return supported;
+#else
+	static const bool supported = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+	return supported;
+#endif
+}
+
+/* float to half, 8 at a time. returns how many were done, the rest is left for the scalar loop */
+LVATT_F16C_TARGET inline size_t f2h_f16c(const float* src, uint16_t* dest, const size_t& count)
+{
+	size_t i = 0;
+	for (; count - i >= 8; i += 8)
+	{
+		__m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), packed);
+	}
+	return i;
+}
+
+/* half to float, 8 at a time. returns how many were done, the rest is left for the scalar loop */
+LVATT_F16C_TARGET inline size_t h2f_f16c(const uint16_t* src, float* dest, const size_t& count)
+{
+	size_t i = 0;
+	for (; count - i >= 8; i += 8)
+	{
+		__m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm256_storeu_ps(dest + i, _mm256_cvtph_ps(packed));
+	}
+	return i;
+}
+#endif
+
+/* float to half array */
+inline void f2h_array(const float* src, uint16_t* dest, const size_t& count)
+{
+	size_t i = 0;
+
+#ifdef LVATT_AVX512
+	for (; count - i >= 16; i += 16)
+	{
+		__m256i packed = _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), packed);
+	}
+#endif
+
+#ifdef LVATT_F16C
+	if (HasF16C())
+	{
+		i += f2h_f16c(src + i, dest + i, count - i);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		dest[i] = FloatToHalf(src[i]);
+	}
+}
+
+/* half to float array */
+inline void h2f_array(const uint16_t* src, float* dest, const size_t& count)
+{
+	size_t i = 0;
+
+#ifdef LVATT_AVX512
+	for (; count - i >= 16; i += 16)
+	{
+		__m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		_mm512_storeu_ps(dest + i, _mm512_cvtph_ps(packed));
+	}
+#endif
+
+#ifdef LVATT_F16C
+	if (HasF16C())
+	{
+		i += h2f_f16c(src + i, dest + i, count - i);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		dest[i] = HalfToFloat(src[i]);
+	}
+}
+
+/* short to float array (inverse of f2s_array) */
+inline void s2f_array(const int16_t* src, float* dest, const size_t& count, const float& normfact)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		dest[i] = float(src[i]) * normfact;
+	}
+}
+
+/// <summary>
+/// how samples are held in memory
+/// </summary>
+enum class SampleStorage
+{
+	Float32,	/* full precision */
+	Float16,	/* IEEE half, ~11 bits of precision at any level, up to ±65504 */
+	Int16,		/* 16 bit fixed point, ±FullScale (clips outside of it) */
+};
+
+/// <summary>
+/// bytes one sample takes up in a storage format
+/// </summary>
+inline size_t SampleStorageSize(const SampleStorage& storage)
+{
+	return storage == SampleStorage::Float32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+/// <summary>
+/// Sample buffer held in a compact format, converted to and from float on store and load.
+/// for audio (or baseband) that gets kept around between stages, after the filters nothing needs more then ~16 bits,
+/// so this halves the memory it takes up and the memory traffic of going over it again. works on whole arrays or block by block, for streaming
+/// </summary>
+class CompactBuffer
+{
+public:
+	/// <summary>
+	/// creates a zeroed buffer
+	/// </summary>
+	/// <param name="size">- amount of samples</param>
+	/// <param name="storage">- storage format</param>
+	/// <param name="fullScale">- largest value Int16 storage can hold</param>
+	CompactBuffer(const size_t& size, const SampleStorage& storage, const float& fullScale = 1.0f)
+	{
+		Size = size;
+		Storage = storage;
+		FullScale = fullScale;
+
+		if (Storage == SampleStorage::Float32)
+		{
+			Wide.resize(Size);
+		}
+		else
+		{
+			Narrow.resize(Size);
+		}
+	}
+
+	/// <summary>
+	/// creates a buffer holding a copy of a float array
+	/// </summary>
+	CompactBuffer(const ArrayWrapper<float>& source, const SampleStorage& storage, const float& fullScale = 1.0f)
+		: CompactBuffer(source.size, storage, fullScale)
+	{
+		Store(source.data, source.size, 0);
+	}
+
+	CompactBuffer() {}
+
+	size_t size() const
+	{
+		return Size;
+	}
+
+	SampleStorage GetStorage() const
+	{
+		return Storage;
+	}
+
+	/// <summary>
+	/// bytes taken up by the samples
+	/// </summary>
+	size_t GetByteSize() const
+	{
+		return Size * SampleStorageSize(Storage);
+	}
+
+	/// <summary>
+	/// the samples themselves, only for Int16 storage (nullptr otherwise), so they can go straight into 16 bit file writers
+	/// </summary>
+	const int16_t* GetInt16Data() const
+	{
+		return Storage == SampleStorage::Int16 ? reinterpret_cast<const int16_t*>(Narrow.data()) : nullptr;
+	}
+
+	/// <summary>
+	/// converts floats into the buffer
+	/// </summary>
+	/// <param name="src">- floats</param>
+	/// <param name="count">- amount of samples</param>
+	/// <param name="offset">- where in the buffer they go</param>
+	void Store(const float* src, const size_t& count, const size_t& offset)
+	{
+		switch (Storage)
+		{
+		case SampleStorage::Float32:
+			std::copy(src, src + count, Wide.data() + offset);
+			break;
+		case SampleStorage::Float16:
+			f2h_array(src, Narrow.data() + offset, count);
+			break;
+		case SampleStorage::Int16:
+		{
+			/* f2s_array goes from ±1, so scale down to that first (in blocks, to stay in cache) */
+			float scaleDown = 1.0f / FullScale;
+			float scaled[256];
+			for (size_t done = 0; done < count; done += 256)
+			{
+				size_t blockCount = std::min<size_t>(256, count - done);
+				for (size_t i = 0; i < blockCount; i++)
+				{
+					scaled[i] = src[done + i] * scaleDown;
+				}
+				f2s_array(scaled, reinterpret_cast<int16_t*>(Narrow.data() + offset + done), blockCount, 1);
+			}
+			break;
+		}
+		}
+	}
+
+	/// <summary>
+	/// converts samples out of the buffer
+	/// </summary>
+	/// <param name="dest">- floats out</param>
+	/// <param name="count">- amount of samples</param>
+	/// <param name="offset">- where in the buffer to start</param>
+	void Load(float* dest, const size_t& count, const size_t& offset) const
+	{
+		switch (Storage)
+		{
+		case SampleStorage::Float32:
+			std::copy(Wide.data() + offset, Wide.data() + offset + count, dest);
+			break;
+		case SampleStorage::Float16:
+			h2f_array(Narrow.data() + offset, dest, count);
+			break;
+		case SampleStorage::Int16:
+			s2f_array(reinterpret_cast<const int16_t*>(Narrow.data() + offset), dest, count, FullScale / float(0x7FFF));
+			break;
+		}
+	}
+
+	/// <summary>
+	/// converts the whole buffer back into a float array
+	/// </summary>
+	ArrayWrapper<float> ToArray() const
+	{
+		ArrayWrapper<float> outArray(Size);
+		Load(outArray.data, Size, 0);
+		return outArray;
+	}
+
+	/// <summary>
+	/// frees the samples
+	/// </summary>
+	void Delete()
+	{
+		Wide = {};
+		Narrow = {};
+		Size = 0;
+	}
+
+private:
+	size_t Size = 0;
+	SampleStorage Storage = SampleStorage::Float32;
+	float FullScale = 1.0f;
+
+	std::vector<float> Wide;
+	std::vector<uint16_t> Narrow;
+};
@@ -1,11 +1,19 @@
+#pragma once
 #include <string>
 #include <complex>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <vector>
+#include <algorithm>
+#include <numbers>
+#include <memory>
 
 #include <DspFilters/Dsp.h>
 #include "Common.hpp"
+#include "SpectrumAnalysis.hpp"
+#include "WAV.hpp"
+#include "BasebandCache.hpp"
 
 #include "../NosLib/String.hpp"
 
@@ -13,7 +21,22 @@ struct InputFile
 {
 	std::string FilePath;
 	size_t FileSampleRate = 2000000;
-	size_t CutOffFrequency = 200000;
+	size_t CutOffFrequency = 0; /* 0 = pick automatically from the occupied bandwidth */
+	bool CorrectCarrierOffset = true;
+
+	/* part of the file to process (SampleCount 0 = until the end) */
+	size_t StartSample = 0;
+	size_t SampleCount = 0;
+
+	/* already known channel (from the activity scanner), skips measuring the occupied bandwidth */
+	double CentreFrequency = 0.0;
+	double Bandwidth = 0.0;
+
+	/* already demodulated audio (WAV file), goes straight to transcribing without the IQ front end */
+	bool IsAudio = false;
+
+	/* keep (and reuse) the decimated baseband, so re-runs skip the full rate filtering */
+	bool UseBasebandCache = false;
 };
 
 /// <summary>
@@ -109,49 +132,664 @@ ArrayWrapper<float> fmDemodulate(ArrayWrapper<std::complex<float>> complexSignal
 }
 
 /// <summary>
-/// Takes in a file name to a IQ file, and returns an audio signal as a float array
+/// Numerically controlled oscillator, shifts a complex signal down by a frequency
+/// </summary>
+class NumericallyControlledOscillator
+{
+public:
+	static constexpr size_t TableSize = 64;
+
+	NumericallyControlledOscillator(const size_t& sampleRate)
+	{
+		SampleRate = sampleRate;
+		SetFrequency(0.0);
+	}
+
+	/// <summary>
+	/// sets the frequency that will get shifted down to 0Hz
+	/// </summary>
+	/// <param name="frequency">- frequency in Hz</param>
+	void SetFrequency(const double& frequency)
+	{
+		Frequency = frequency;
+
+		/* table of the rotation for the first TableSize samples, then the whole table gets rotated by TableStep */
+		for (size_t i = 0; i < TableSize; i++)
+		{
+			Table[i] = std::complex<float>(std::polar(1.0, -2.0 * std::numbers::pi * Frequency * double(i) / double(SampleRate)));
+		}
+		TableStep = std::polar(1.0, -2.0 * std::numbers::pi * Frequency * double(TableSize) / double(SampleRate));
+	}
+
+	double GetFrequency()
+	{
+		return Frequency;
+	}
+
+	/// <summary>
+	/// mixes the signal with the oscillator in place
+	/// </summary>
+	/// <param name="data">- complex signal</param>
+	/// <param name="count">- amount of samples</param>
+	void Process(std::complex<float>* data, const size_t& count)
+	{
+		if (Frequency == 0.0)
+		{
+			return;
+		}
+
+		for (size_t offset = 0; offset < count; offset += TableSize)
+		{
+			size_t blockCount = std::min(TableSize, count - offset);
+			std::complex<float> phase(Phase);
+
+			for (size_t i = 0; i < blockCount; i++)
+			{
+				data[offset + i] *= Table[i] * phase;
+			}
+
+			Phase *= TableStep;
+		}
+
+		/* stop rounding errors from slowly changing the amplitude */
+		Phase /= std::abs(Phase);
+	}
+
+private:
+	size_t SampleRate;
+	double Frequency = 0.0;
+
+	std::complex<float> Table[TableSize];
+	std::complex<double> TableStep;
+	std::complex<double> Phase = 1.0;
+};
+
+/// <summary>
+/// Streaming version of LowPassFilterComplex, keeps the filter state between blocks
+/// </summary>
+class ComplexLowPassFilter
+{
+public:
+	static constexpr int MaxOrder = 8;
+
+	/// <param name="sampleRate">- signal's sample rate</param>
+	/// <param name="cutOffFrequency">- frequency used for low pass (start of the stop band)</param>
+	/// <param name="order">- filter order (up to MaxOrder)</param>
+	/// <param name="stopBandDb">- stop band attenuation</param>
+	ComplexLowPassFilter(const size_t& sampleRate, const double& cutOffFrequency, const int& order = 3, const double& stopBandDb = 1.0)
+	{
+		Filter.setup(order, sampleRate, cutOffFrequency, stopBandDb);
+	}
+
+	/// <summary>
+	/// filters complex signal in place
+	/// </summary>
+	/// <param name="data">- complex signal</param>
+	/// <param name="count">- amount of samples</param>
+	void Process(std::complex<float>* data, const size_t& count)
+	{
+		InPhase.resize(count);
+		Quadrature.resize(count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			InPhase[i] = data[i].real();
+			Quadrature[i] = data[i].imag();
+		}
+
+		float* channels[2] = {InPhase.data(), Quadrature.data()};
+		Filter.process(count, channels);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			data[i] = std::complex<float>(InPhase[i], Quadrature[i]);
+		}
+	}
+
+private:
+	Dsp::SimpleFilter<Dsp::ChebyshevII::LowPass<MaxOrder>, 2> Filter;
+
+	std::vector<float> InPhase;
+	std::vector<float> Quadrature;
+};
+
+/// <summary>
+/// Streaming version of DownSample, keeps track of where the next sample to keep is between blocks
+/// </summary>
+class Decimator
+{
+public:
+	Decimator(const size_t& factor)
+	{
+		Factor = factor;
+	}
+
+	/// <summary>
+	/// takes every Factor-th sample
+	/// </summary>
+	/// <param name="input">- complex signal in</param>
+	/// <param name="count">- amount of samples in input</param>
+	/// <param name="output">- complex signal out (can be the same as input)</param>
+	/// <returns>amount of samples written to output</returns>
+	size_t Process(const std::complex<float>* input, const size_t& count, std::complex<float>* output)
+	{
+		size_t written = 0;
+		size_t i = Next;
+
+		for (; i < count; i += Factor)
+		{
+			output[written] = input[i];
+			written++;
+		}
+
+		Next = i - count;
+		return written;
+	}
+
+	size_t GetFactor()
+	{
+		return Factor;
+	}
+
+private:
+	size_t Factor;
+	size_t Next = 0;
+};
+
+/// <summary>
+/// Streaming version of fmDemodulate, keeps the last sample between blocks
+/// </summary>
+class FmDemodulator
+{
+public:
+	/// <summary>
+	/// FM demodulates a block
+	/// </summary>
+	/// <param name="input">- complex signal</param>
+	/// <param name="count">- amount of samples</param>
+	/// <param name="output">- audio out</param>
+	void Process(const std::complex<float>* input, const size_t& count, float* output)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			output[i] = std::arg(input[i] * std::conj(Previous));
+			Previous = input[i];
+		}
+	}
+
+private:
+	std::complex<float> Previous = 0.0f;
+};
+
+/// <summary>
+/// Estimates the carrier frequency offset on the decimated baseband.
+/// The average phase step between samples (weighted by power) is the average frequency, which for FM is the carrier offset.
+/// </summary>
+class CarrierOffsetEstimator
+{
+public:
+	/// <param name="sampleRate">- sample rate of the decimated baseband</param>
+	/// <param name="windowSeconds">- how much signal each estimate is made from</param>
+	/// <param name="minConfidence">- how tone like the window has to be (0 to 1) for the estimate to be used, noise is close to 0</param>
+	CarrierOffsetEstimator(const size_t& sampleRate, const float& windowSeconds = 0.02f, const float& minConfidence = 0.3f)
+	{
+		SampleRate = sampleRate;
+		WindowSize = std::max<size_t>(size_t(sampleRate * windowSeconds), 16);
+		MinConfidence = minConfidence;
+	}
+
+	/// <summary>
+	/// takes in a block of baseband, every time a window is complete it gives out an estimate
+	/// </summary>
+	/// <param name="data">- decimated complex signal</param>
+	/// <param name="count">- amount of samples</param>
+	/// <param name="offsetOut">- the estimated offset in Hz, only set if true was returned</param>
+	/// <returns>true if a new (confident) estimate was made</returns>
+	bool Process(const std::complex<float>* data, const size_t& count, double* offsetOut)
+	{
+		bool estimated = false;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			Correlation += std::complex<double>(data[i] * std::conj(Previous));
+			Power += std::norm(Previous);
+			Previous = data[i];
+			Counted++;
+
+			if (Counted < WindowSize)
+			{
+				continue;
+			}
+
+			if (Power > 0.0 && std::abs(Correlation) / Power >= MinConfidence)
+			{
+				*offsetOut = std::arg(Correlation) * double(SampleRate) / (2.0 * std::numbers::pi);
+				estimated = true;
+			}
+
+			Correlation = 0.0;
+			Power = 0.0;
+			Counted = 0;
+		}
+
+		return estimated;
+	}
+
+private:
+	size_t SampleRate;
+	size_t WindowSize;
+	float MinConfidence;
+
+	std::complex<float> Previous = 0.0f;
+	std::complex<double> Correlation = 0.0;
+	double Power = 0.0;
+	size_t Counted = 0;
+};
+
+/// <summary>
+/// one stage of decimation, a low pass followed by keeping every Factor-th sample
+/// </summary>
+struct DecimationStage
+{
+	size_t InSampleRate;
+	size_t Factor;
+	double CutOffFrequency;	/* start of the stop band */
+	int Order;
+	double StopBandDb;
+};
+
+/// <summary>
+/// the original single stage front end: one low pass at the file's rate, then straight down to the out rate
+/// </summary>
+/// <param name="fileSampleRate">- sample rate of the IQ</param>
+/// <param name="cutOffFrequency">- low pass cut off</param>
+/// <param name="outSampleRate">- wanted sample rate</param>
+/// <returns>decimation plan</returns>
+std::vector<DecimationStage> SingleStagePlan(const size_t& fileSampleRate, const size_t& cutOffFrequency, const size_t& outSampleRate)
+{
+	/* if target sample rate is more then current sample rate, throw error (you can't up sample this easy) */
+	if (fileSampleRate < outSampleRate)
+	{
+		throw std::invalid_argument("current sample rate has to be more then the target sample rate");
+	}
+
+	return {DecimationStage{fileSampleRate, fileSampleRate / outSampleRate, double(cutOffFrequency), 3, 1.0}};
+}
+
+/// <summary>
+/// lowest order ChebyshevII low pass that starts its stop band at stopFrequency, and is still flat (less then 1dB down) at passFrequency
+/// </summary>
+int ChooseFilterOrder(const size_t& sampleRate, const double& passFrequency, const double& stopFrequency, const double& stopBandDb)
+{
+	for (int order = 2; order < ComplexLowPassFilter::MaxOrder; order++)
+	{
+		Dsp::SimpleFilter<Dsp::ChebyshevII::LowPass<ComplexLowPassFilter::MaxOrder>, 1> filter;
+		filter.setup(order, sampleRate, stopFrequency, stopBandDb);
+
+		if (std::abs(filter.response(passFrequency / double(sampleRate))) >= 0.891) /* -1dB */
+		{
+			return order;
+		}
+	}
+
+	return ComplexLowPassFilter::MaxOrder;
+}
+
+/// <summary>
+/// Plans a multi stage decimation which keeps +-passBandwidth.
+/// the decimation factor is split into stages (biggest first), so the narrow (steep) filter only runs at the lowest rate,
+/// and the earlier stages only have to stop what would alias into the pass band, so they can use low orders
+/// </summary>
+/// <param name="fileSampleRate">- sample rate of the IQ</param>
+/// <param name="outSampleRate">- wanted sample rate</param>
+/// <param name="passBandwidth">- one sided bandwidth to keep</param>
+/// <returns>decimation plan</returns>
+std::vector<DecimationStage> PlanDecimation(const size_t& fileSampleRate, const size_t& outSampleRate, double passBandwidth)
+{
+	const size_t maxStageFactor = 16;
+	const double stopBandDb = 60.0;
+	const double finalTransition = 1.7; /* stop band start / pass band end for the last (steep) stage */
+
+	if (fileSampleRate < outSampleRate)
+	{
+		throw std::invalid_argument("current sample rate has to be more then the target sample rate");
+	}
+
+	/* the last stage's stop band has to fit under the out rate */
+	passBandwidth = std::min(passBandwidth, double(outSampleRate) / (finalTransition + 1.0));
+
+	/* split factor into primes, biggest first, then group them into stages */
+	size_t factor = fileSampleRate / outSampleRate;
+	std::vector<size_t> primes;
+	for (size_t prime = 2, left = factor; left > 1;)
+	{
+		if (left % prime == 0)
+		{
+			primes.push_back(prime);
+			left /= prime;
+		}
+		else
+		{
+			prime++;
+		}
+	}
+	std::sort(primes.rbegin(), primes.rend());
+
+	std::vector<size_t> stageFactors;
+	size_t current = 1;
+	for (size_t prime : primes)
+	{
+		if (current != 1 && current * prime > maxStageFactor)
+		{
+			stageFactors.push_back(current);
+			current = 1;
+		}
+		current *= prime;
+	}
+	stageFactors.push_back(current);
+
+	std::vector<DecimationStage> plan;
+	size_t rate = fileSampleRate;
+
+	for (size_t i = 0; i < stageFactors.size(); i++)
+	{
+		size_t stageOutRate = rate / stageFactors[i];
+		double cutOff;
+
+		if (i + 1 == stageFactors.size())
+		{
+			cutOff = std::min(passBandwidth * finalTransition, double(stageOutRate) - passBandwidth);
+		}
+		else
+		{
+			/* only has to stop what would alias into the pass band */
+			cutOff = double(stageOutRate) - passBandwidth;
+		}
+		cutOff = std::min(cutOff, double(rate) * 0.45);
+
+		plan.push_back(DecimationStage{rate, stageFactors[i], cutOff, ChooseFilterOrder(rate, passBandwidth, cutOff, stopBandDb), stopBandDb});
+		rate = stageOutRate;
+	}
+
+	return plan;
+}
+
+/// <summary>
+/// Picks the decimation plan for a file. If the cut off is 0, the occupied bandwidth and centre of the strongest signal get measured (Welch PSD)
+/// and the channel filter gets set as narrow as the signal allows
 /// </summary>
-/// <param name="iqFileName">- name to IQ file</param>
-/// <returns>array of floats</returns>
-ArrayWrapper<float> IQtoAudio(const std::string& iqFilePath, const size_t& FileSampleRate, const size_t& CutOffFrequency, const size_t& outSampleRate)
+/// <param name="inputFile">- IQ file and its settings</param>
+/// <param name="outSampleRate">- wanted sample rate</param>
+/// <param name="carrierOffsetOut">- where the signal is centred (used to start the NCO off)</param>
+/// <returns>decimation plan</returns>
+std::vector<DecimationStage> PlanFrontEnd(const InputFile& inputFile, const size_t& outSampleRate, double* carrierOffsetOut)
 {
-	if (!std::filesystem::exists(iqFilePath)) /* if doesn't exist, just return */
+	*carrierOffsetOut = 0.0;
+
+	if (inputFile.CutOffFrequency != 0)
+	{
+		return SingleStagePlan(inputFile.FileSampleRate, inputFile.CutOffFrequency, outSampleRate);
+	}
+
+	if (inputFile.Bandwidth != 0.0)
 	{
-		printf("not file found at: %s\n", iqFilePath.c_str());
-		return ArrayWrapper<float>();
+		*carrierOffsetOut = inputFile.CentreFrequency;
+		return PlanDecimation(inputFile.FileSampleRate, outSampleRate, inputFile.Bandwidth / 2.0);
+	}
+
+	SpectrumBand band;
+	if (!EstimateOccupiedBand(inputFile.FilePath, inputFile.FileSampleRate, &band))
+	{
+		printf("No signal found in spectrum, using widest channel filter\n");
+		return PlanDecimation(inputFile.FileSampleRate, outSampleRate, double(outSampleRate) / 2.0);
+	}
+
+	printf("Occupied bandwidth: %.0fHz, centred at %.0fHz (%.1fdB)\n", band.Bandwidth, band.CentreFrequency, band.PowerDb);
+
+	*carrierOffsetOut = band.CentreFrequency;
+	return PlanDecimation(inputFile.FileSampleRate, outSampleRate, band.Bandwidth / 2.0);
+}
+
+/// <summary>
+/// Streaming front end, takes in full rate IQ and gives out decimated baseband.
+/// NCO -> (low pass -> decimate) for each stage, with the carrier offset estimated on the decimated baseband and fed back into the NCO
+/// </summary>
+class BasebandConverter
+{
+public:
+	/// <param name="plan">- decimation stages</param>
+	/// <param name="carrierOffset">- frequency to start the NCO at</param>
+	/// <param name="correctCarrierOffset">- if the carrier offset should be tracked</param>
+	BasebandConverter(const std::vector<DecimationStage>& plan, const double& carrierOffset = 0.0, const bool& correctCarrierOffset = true)
+		: Oscillator(plan.front().InSampleRate), OffsetEstimator(plan.back().InSampleRate / plan.back().Factor)
+	{
+		for (const DecimationStage& stage : plan)
+		{
+			Stages.push_back(std::make_unique<ConversionStage>(stage));
+			DecimationFactor *= stage.Factor;
+		}
+
+		CorrectCarrierOffset = correctCarrierOffset;
+		MaxOffset = double(plan.front().InSampleRate) / 2.0;
+		Oscillator.SetFrequency(carrierOffset);
+	}
+
+	/// <summary>
+	/// processes a block of full rate IQ
+	/// </summary>
+	/// <param name="data">- full rate IQ, gets used as scratch space (and holds the output)</param>
+	/// <param name="count">- amount of samples</param>
+	/// <returns>amount of decimated samples, they are at the start of data</returns>
+	size_t Process(std::complex<float>* data, const size_t& count)
+	{
+		Oscillator.Process(data, count);
+
+		size_t decimatedCount = count;
+		for (std::unique_ptr<ConversionStage>& stage : Stages)
+		{
+			stage->LowPass.Process(data, decimatedCount);
+			decimatedCount = stage->Downsampler.Process(data, decimatedCount, data);
+		}
+
+		double residualOffset;
+		if (CorrectCarrierOffset && OffsetEstimator.Process(data, decimatedCount, &residualOffset))
+		{
+			/* only move part of the way, so one bad window can't throw the oscillator off */
+			double frequency = Oscillator.GetFrequency() + residualOffset * LoopGain;
+			Oscillator.SetFrequency(std::clamp(frequency, -MaxOffset, MaxOffset));
+		}
+
+		return decimatedCount;
+	}
+
+	/// <summary>
+	/// how much the incoming signal is being shifted by at the moment
+	/// </summary>
+	double GetCarrierOffset()
+	{
+		return Oscillator.GetFrequency();
+	}
+
+	size_t GetDecimationFactor()
+	{
+		return DecimationFactor;
+	}
+
+private:
+	static constexpr double LoopGain = 0.25;
+
+	/* DSPFilters' cascades point into themselves, so the filters can't be copied or moved, only constructed in place */
+	struct ConversionStage
+	{
+		ComplexLowPassFilter LowPass;
+		Decimator Downsampler;
+
+		ConversionStage(const DecimationStage& stage)
+			: LowPass(stage.InSampleRate, stage.CutOffFrequency, stage.Order, stage.StopBandDb), Downsampler(stage.Factor) {}
+	};
+
+	NumericallyControlledOscillator Oscillator;
+	std::vector<std::unique_ptr<ConversionStage>> Stages;
+	CarrierOffsetEstimator OffsetEstimator;
+	size_t DecimationFactor = 1;
+
+	bool CorrectCarrierOffset;
+	double MaxOffset;
+};
+
+/* amount of IQ samples read (and processed) at once */
+const size_t IQBlockSize = 1 << 16;
+
+/* how the demodulated audio is held until the noise reducer, the discriminator only gives out ±π, which half floats hold to ~11 bits */
+const SampleStorage DemodulatedStorage = SampleStorage::Float16;
+
+/// <summary>
+/// key of the baseband cache for an IQ file, from its content and every setting that changes the front end's output
+/// </summary>
+/// <param name="inputFile">- IQ file and its settings</param>
+/// <param name="outSampleRate">- sample rate of the audio</param>
+/// <returns>cache key</returns>
+inline uint64_t BasebandCacheKey(const InputFile& inputFile, const size_t& outSampleRate)
+{
+	uint64_t key = HashFileSampled(inputFile.FilePath);
+
+	uint64_t settings[] = { BasebandCacheVersion, inputFile.FileSampleRate, inputFile.CutOffFrequency, inputFile.CorrectCarrierOffset,
+		inputFile.StartSample, inputFile.SampleCount, std::bit_cast<uint64_t>(inputFile.CentreFrequency), std::bit_cast<uint64_t>(inputFile.Bandwidth), outSampleRate };
+
+	return Fnv1a(settings, sizeof(settings), key);
+}
+
+/// <summary>
+/// Takes in a IQ file, and returns an audio signal in DemodulatedStorage (each block gets demodulated as float, then stored compact)
+/// </summary>
+/// <param name="inputFile">- IQ file and its settings</param>
+/// <param name="outSampleRate">- sample rate of the audio</param>
+/// <returns>audio signal, empty if there was none</returns>
+CompactBuffer IQtoAudio(const InputFile& inputFile, const size_t& outSampleRate)
+{
+	if (!std::filesystem::exists(inputFile.FilePath)) /* if doesn't exist, just return */
+	{
+		printf("not file found at: %s\n", inputFile.FilePath.c_str());
+		return CompactBuffer();
 	}
 
 	/* Open IQ file */
-	std::ifstream inputFile(iqFilePath, std::ios::binary);
-	inputFile.seekg(0, std::ios::end);
+	std::ifstream iqStream(inputFile.FilePath, std::ios::binary);
+
+	/* Calculate number of samples, and skip to the part that should be processed */
+	size_t fileSampleCount = std::filesystem::file_size(inputFile.FilePath) / sizeof(std::complex<float>);
+	size_t startSample = std::min(inputFile.StartSample, fileSampleCount);
+	size_t sampleCount = fileSampleCount - startSample;
+
+	if (inputFile.SampleCount != 0)
+	{
+		sampleCount = std::min(sampleCount, inputFile.SampleCount);
+	}
+
+	iqStream.seekg(startSample * sizeof(std::complex<float>), std::ios::beg);
+
+	printf("Processing %s\nIn Sample rate: %zuHz\nSamples: %zuHz\nLenght: %fs\nOut Sample rate: %zuHz\n", inputFile.FilePath.c_str(), inputFile.FileSampleRate, sampleCount, float(sampleCount)/float(inputFile.FileSampleRate), outSampleRate);
+
+	/* decimated baseband from an earlier run with the same file and settings, only needs demodulating */
+	uint64_t cacheKey = 0;
+	std::filesystem::path cachePath;
+
+	if (inputFile.UseBasebandCache)
+	{
+		cacheKey = BasebandCacheKey(inputFile, outSampleRate);
+
+		char cacheName[32];
+		snprintf(cacheName, sizeof(cacheName), "%016llx.baseband", (unsigned long long)cacheKey);
+		cachePath = std::filesystem::path(BasebandCacheDirectory) / cacheName;
+
+		BasebandCacheReader cache(cachePath, cacheKey, uint32_t(outSampleRate));
+		if (cache.IsOpen())
+		{
+			printf("Using cached baseband %s\n", cachePath.string().c_str());
+
+			FmDemodulator demodulator;
+			CompactBuffer audio(cache.GetSampleCount(), DemodulatedStorage);
+			std::vector<std::complex<float>> block(BasebandCacheBlockSize);
+			std::vector<float> demodulated(BasebandCacheBlockSize);
+			size_t written = 0;
+
+			for (size_t blockCount; (blockCount = cache.Read(block.data())) != 0;)
+			{
+				demodulator.Process(block.data(), blockCount, demodulated.data());
+				audio.Store(demodulated.data(), blockCount, written);
+				written += blockCount;
+			}
+
+			if (written == audio.size())
+			{
+				if (inputFile.CorrectCarrierOffset)
+				{
+					printf("Carrier offset: %.1fHz\n", cache.GetCarrierOffset());
+				}
+
+				return audio;
+			}
+
+			printf("Cached baseband is cut off, processing the IQ file again\n");
+			audio.Delete();
+		}
+	}
+
+	double carrierOffset;
+	std::vector<DecimationStage> plan = PlanFrontEnd(inputFile, outSampleRate, &carrierOffset);
+
+	for (const DecimationStage& stage : plan)
+	{
+		printf("Decimation stage: %zuHz / %zu, cut off %.0fHz (order %d)\n", stage.InSampleRate, stage.Factor, stage.CutOffFrequency, stage.Order);
+	}
+
+	/* filter, down sample and demodulate block by block as the file gets read */
+	printf("Reading, filtering, down sampling and FM demodulating complex signal\n");
+	BasebandConverter converter(plan, carrierOffset, inputFile.CorrectCarrierOffset);
+	FmDemodulator demodulator;
+
+	std::unique_ptr<BasebandCacheWriter> cacheWriter;
+	if (inputFile.UseBasebandCache)
+	{
+		cacheWriter = std::make_unique<BasebandCacheWriter>(cachePath, cacheKey, uint32_t(outSampleRate), inputFile.FilePath);
+	}
+
+	size_t decimationFactor = converter.GetDecimationFactor();
+	CompactBuffer audio((sampleCount + decimationFactor - 1) / decimationFactor, DemodulatedStorage);
+	size_t written = 0;
 
-	/* Calculate number of samples and create array */
-	ArrayWrapper<std::complex<float>> ComplexSignal(inputFile.tellg() / sizeof(std::complex<float>));
+	std::vector<std::complex<float>> block(IQBlockSize);
+	std::vector<float> demodulated(IQBlockSize);
 
-	/* reset stream position */
-	inputFile.seekg(0, std::ios::beg);
+	for (size_t read = 0; read < sampleCount;)
+	{
+		size_t blockCount = std::min(IQBlockSize, sampleCount - read);
+		iqStream.read(reinterpret_cast<char*>(block.data()), blockCount * sizeof(std::complex<float>));
 
-	printf("Processing %s\nIn Sample rate: %zuHz\nSamples: %zuHz\nLenght: %fs\nOut Sample rate: %zuHz\n", iqFilePath.c_str(), FileSampleRate, ComplexSignal.size, float(ComplexSignal.size)/float(FileSampleRate), outSampleRate);
+		size_t decimatedCount = converter.Process(block.data(), blockCount);
 
-	/* read data and put it into array */
-	printf("Reading complex signal from file\n");
-	inputFile.read(reinterpret_cast<char*>(ComplexSignal.data), ComplexSignal.size * sizeof(std::complex<float>));
-	inputFile.close();
+		if (cacheWriter)
+		{
+			cacheWriter->Write(block.data(), decimatedCount);
+		}
 
-	/* do a low pass filter on the data */
-	printf("Filtering complex signal\n");
-	ArrayWrapper<std::complex<float>> filteredSignal = LowPassFilterComplex(ComplexSignal, FileSampleRate, CutOffFrequency);
-	ComplexSignal.Delete();
+		demodulator.Process(block.data(), decimatedCount, demodulated.data());
+		audio.Store(demodulated.data(), decimatedCount, written);
 
-	/* down sample the data */
-	printf("Down sampling complex signal\n");
-	ArrayWrapper<std::complex<float>> downSampledSignal = DownSample(filteredSignal, FileSampleRate, outSampleRate);
-	filteredSignal.Delete();
+		written += decimatedCount;
+		read += blockCount;
+	}
 
-	/* do a FM demodulation on the data */
-	printf("FM Demodulating the complex signal\n");
-	ArrayWrapper<float> audio = fmDemodulate(downSampledSignal);
-	downSampledSignal.Delete();
+	if (inputFile.CorrectCarrierOffset)
+	{
+		printf("Carrier offset: %.1fHz\n", converter.GetCarrierOffset());
+	}
+
+	if (cacheWriter)
+	{
+		cacheWriter->Finish(converter.GetCarrierOffset());
+		printf("Cached baseband to %s\n", cachePath.string().c_str());
+	}
 
 	return audio;
 }
@@ -160,13 +798,18 @@ ArrayWrapper<float> IQtoAudio(const std::string& iqFilePath, const size_t& FileS
 const size_t DefaultInSampleRate = 2000000; /* 2Mhz */
 
 /* Low Pass Filter */
-const size_t DefaultCutOffFrequency = 200000; /* 200Khz */
+const size_t DefaultCutOffFrequency = 0; /* automatic, from the occupied bandwidth */
 //const int CutOffFrequency = 5000000; /* 5Mhz */
 
-ArrayWrapper<InputFile> GatherUserInput()
+/// <summary>
+/// asks for the files to process and their settings
+/// </summary>
+/// <param name="askCutOff">- false leaves the cut off on auto (scan mode, every transmission gets filtered to its own channel)</param>
+/// <returns>files</returns>
+ArrayWrapper<InputFile> GatherUserInput(const bool& askCutOff = true)
 {
 	std::string paths;
-	printf("Input path to IQ file\\s [Separate each path with ,]: ");
+	printf("Input path to IQ or WAV audio file\\s [Separate each path with ,]: ");
 	std::getline(std::cin, paths);
 
 	NosLib::DynamicArray<std::string> splitOut;
@@ -179,6 +822,15 @@ ArrayWrapper<InputFile> GatherUserInput()
 		InputFile currentInput;
 		currentInput.FilePath = NosLib::String::Trim(splitOut[i]);
 
+		/* WAV audio has its own sample rate in the header, and has no IQ front end to set up */
+		if (IsWavFile(currentInput.FilePath))
+		{
+			printf("\n\"%s\" is WAV audio, skipping the IQ front end\n", splitOut[i].c_str());
+			currentInput.IsAudio = true;
+			outArray[i] = currentInput;
+			continue;
+		}
+
 		while (true)
 		{
 			std::string input;
@@ -199,30 +851,52 @@ ArrayWrapper<InputFile> GatherUserInput()
 
 			printf("Input was invalid, try again\n");
 		}
-		
-		while (true)
-		{
-			std::string input;
-			printf("\nPlease input the Cut off frequency for \"%s\" [Default:%zuHz]: ", splitOut[i].c_str(), DefaultCutOffFrequency);
-			std::getline(std::cin, input);
 
-			if (input.empty())
-			{
-				printf("Using default value: %zuHz\n", DefaultCutOffFrequency);
-				currentInput.CutOffFrequency = DefaultCutOffFrequency;
-				break;
-			}
-
-			if (1 == sscanf(input.c_str(), "%zu", &currentInput.CutOffFrequency))
+		if (askCutOff)
+		{
+			while (true)
 			{
-				break;
+				std::string input;
+				printf("\nPlease input the Cut off frequency for \"%s\" [Default:auto]: ", splitOut[i].c_str());
+				std::getline(std::cin, input);
+
+				if (input.empty() || input == "auto")
+				{
+					printf("Using default value: auto\n");
+					currentInput.CutOffFrequency = DefaultCutOffFrequency;
+					break;
+				}
+
+				if (1 == sscanf(input.c_str(), "%zu", &currentInput.CutOffFrequency))
+				{
+					break;
+				}
+
+				printf("Input was invalid, try again\n");
 			}
-
-			printf("Input was invalid, try again\n");
 		}
 
 		outArray[i] = currentInput;
 	}
 
+	bool hasIQ = false;
+	for (size_t i = 0; i < outArray.size; i++)
+	{
+		hasIQ |= !outArray.data[i].IsAudio;
+	}
+
+	if (hasIQ)
+	{
+		std::string input;
+		printf("\nCache the decimated baseband, so re-runs on the same files skip the filtering? [y/N]: ");
+		std::getline(std::cin, input);
+
+		bool useCache = (input == "y" || input == "Y");
+		for (size_t i = 0; i < outArray.size; i++)
+		{
+			outArray.data[i].UseBasebandCache = useCache;
+		}
+	}
+
 	return outArray;
 }
\ No newline at end of file
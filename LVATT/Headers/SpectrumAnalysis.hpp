@@ -0,0 +1,483 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <complex>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+#include "Common.hpp"
+#include "FFT.hpp"
+
+/// <summary>
+/// part of a spectrum that has a signal in it
+/// </summary>
+struct SpectrumBand
+{
+	double CentreFrequency = 0.0;	/* relative to the middle of the capture */
+	double Bandwidth = 0.0;			/* occupied bandwidth */
+	float PowerDb = 0.0f;			/* total power of the band (dB relative to full scale) */
+};
+
+/// <summary>
+/// Power spectral density, with 0Hz in the middle (bin i is (i - Size/2) * SampleRate / Size Hz).
+/// bins are normalised so that they add up to the mean power of the signal
+/// </summary>
+struct PowerSpectrum
+{
+	std::vector<float> Power;
+	size_t SampleRate = 0;
+
+	double BinWidth() const
+	{
+		return double(SampleRate) / double(Power.size());
+	}
+
+	double BinFrequency(const double& bin) const
+	{
+		return (bin - double(Power.size() / 2)) * BinWidth();
+	}
+};
+
+/// <summary>
+/// accumulates the windowed power spectrum of a complex block, and fftshifts it into the output
+/// </summary>
+/// <param name="transform">- FFT to use</param>
+/// <param name="window">- window (same size as the FFT)</param>
+/// <param name="data">- complex samples (FFT size long)</param>
+/// <param name="real">- scratch, FFT size long</param>
+/// <param name="imag">- scratch, FFT size long</param>
+/// <param name="powerOut">- power gets added into this</param>
+inline void AccumulatePowerSpectrum(FFT& transform, const std::vector<float>& window, const std::complex<float>* data, float* real, float* imag, float* powerOut)
+{
+	size_t size = transform.GetSize();
+
+	for (size_t i = 0; i < size; i++)
+	{
+		real[i] = data[i].real() * window[i];
+		imag[i] = data[i].imag() * window[i];
+	}
+
+	transform.Forward(real, imag);
+
+	size_t half = size / 2;
+	for (size_t i = 0; i < size; i++)
+	{
+		size_t bin = (i + half) & (size - 1);
+		powerOut[i] += real[bin] * real[bin] + imag[bin] * imag[bin];
+	}
+}
+
+/// <summary>
+/// Welch PSD of an IQ file. Reads sectionCount sections spread evenly over the file (so bursty traffic still gets seen),
+/// and averages 50% overlapped Hann windowed FFTs over them. sections get processed in parallel
+/// </summary>
+/// <param name="iqFilePath">- path to IQ file (complex float)</param>
+/// <param name="sampleRate">- sample rate of the file</param>
+/// <param name="fftSize">- FFT size (resolution is sampleRate/fftSize)</param>
+/// <param name="sampleSeconds">- how much of the file to look at in total</param>
+/// <param name="sectionCount">- how many places in the file to look at</param>
+/// <returns>power spectrum (empty if file couldn't be read)</returns>
+PowerSpectrum WelchPowerSpectrum(const std::string& iqFilePath, const size_t& sampleRate, const size_t& fftSize = 4096, const float& sampleSeconds = 2.0f, const size_t& sectionCount = 16)
+{
+	PowerSpectrum spectrum;
+	spectrum.SampleRate = sampleRate;
+
+	if (!std::filesystem::exists(iqFilePath))
+	{
+		return spectrum;
+	}
+
+	size_t sampleCount = std::filesystem::file_size(iqFilePath) / sizeof(std::complex<float>);
+	size_t sectionLength = std::max(size_t(sampleSeconds * sampleRate) / sectionCount, fftSize);
+
+	if (sampleCount < fftSize)
+	{
+		return spectrum;
+	}
+
+	size_t sections = std::min(sectionCount, std::max<size_t>(sampleCount / sectionLength, 1));
+	sectionLength = std::min(sectionLength, sampleCount);
+
+	std::vector<float> window = HannWindow(fftSize);
+	std::vector<std::vector<float>> sectionPower(sections, std::vector<float>(fftSize, 0.0f));
+	std::vector<size_t> sectionSegments(sections, 0);
+
+	ParallelFor(sections, [&](size_t begin, size_t end)
+		{
+			FFT transform(fftSize);
+			std::ifstream iqStream(iqFilePath, std::ios::binary);
+			std::vector<std::complex<float>> block(sectionLength);
+			std::vector<float> real(fftSize), imag(fftSize);
+
+			for (size_t section = begin; section < end; section++)
+			{
+				/* spread sections evenly from start to end of file */
+				size_t start = sections > 1 ? (sampleCount - sectionLength) / (sections - 1) * section : 0;
+
+				iqStream.seekg(start * sizeof(std::complex<float>), std::ios::beg);
+				iqStream.read(reinterpret_cast<char*>(block.data()), sectionLength * sizeof(std::complex<float>));
+
+				for (size_t offset = 0; offset + fftSize <= sectionLength; offset += fftSize / 2)
+				{
+					AccumulatePowerSpectrum(transform, window, block.data() + offset, real.data(), imag.data(), sectionPower[section].data());
+					sectionSegments[section]++;
+				}
+			}
+		});
+
+	/* average, and normalise so the bins add up to the mean power (window power and FFT size taken out) */
+	double windowPower = 0.0;
+	for (float value : window)
+	{
+		windowPower += value * value;
+	}
+
+	size_t segments = 0;
+	spectrum.Power.assign(fftSize, 0.0f);
+	for (size_t section = 0; section < sections; section++)
+	{
+		segments += sectionSegments[section];
+		for (size_t i = 0; i < fftSize; i++)
+		{
+			spectrum.Power[i] += sectionPower[section][i];
+		}
+	}
+
+	float scale = float(1.0 / (double(std::max<size_t>(segments, 1)) * double(fftSize) * windowPower));
+	for (float& value : spectrum.Power)
+	{
+		value *= scale;
+	}
+
+	return spectrum;
+}
+
+/// <summary>
+/// Noise floor estimate (median bin power, most of a spectrum is noise)
+/// </summary>
+/// <param name="power">- power spectrum bins</param>
+/// <param name="count">- amount of bins</param>
+/// <returns>noise floor power per bin</returns>
+inline float EstimateNoiseFloor(const float* power, const size_t& count)
+{
+	std::vector<float> sorted(power, power + count);
+	std::nth_element(sorted.begin(), sorted.begin() + count / 2, sorted.end());
+	return sorted[count / 2];
+}
+
+/// <summary>
+/// Finds all bands that are above the noise floor.
+/// runs of bins above the threshold get joined up if the gap between them is small, then extended out to where they drop to near the noise floor,
+/// and the occupied bandwidth is the part of the band holding occupiedFraction of the power above the floor
+/// </summary>
+/// <param name="power">- fftshifted power spectrum bins</param>
+/// <param name="count">- amount of bins</param>
+/// <param name="sampleRate">- sample rate of the spectrum</param>
+/// <param name="noiseFloor">- noise floor power per bin</param>
+/// <param name="thresholdDb">- how far above the noise floor a bin has to be to count as signal</param>
+/// <param name="minBins">- bands narrower then this get dropped (DC spike, spurs)</param>
+/// <param name="occupiedFraction">- fraction of power used for the occupied bandwidth</param>
+/// <returns>bands, ordered by frequency</returns>
+inline std::vector<SpectrumBand> DetectBands(const float* power, const size_t& count, const size_t& sampleRate, const float& noiseFloor, const float& thresholdDb = 10.0f, const size_t& minBins = 3, const double& occupiedFraction = 0.99)
+{
+	const size_t mergeGap = 3;
+	const float threshold = noiseFloor * std::pow(10.0f, thresholdDb / 10.0f);
+	const float edge = noiseFloor * 2.0f; /* 3dB above the floor */
+	const double binWidth = double(sampleRate) / double(count);
+
+	std::vector<SpectrumBand> bands;
+
+	size_t i = 0;
+	while (i < count)
+	{
+		if (power[i] <= threshold)
+		{
+			i++;
+			continue;
+		}
+
+		/* find end of this run, joining runs with small gaps */
+		size_t low = i;
+		size_t high = i;
+		for (size_t j = i + 1; j < count && j <= high + mergeGap + 1; j++)
+		{
+			if (power[j] > threshold)
+			{
+				high = j;
+			}
+		}
+		i = high + 1;
+
+		/* extend out to the skirts */
+		while (low > 0 && power[low - 1] > edge)
+		{
+			low--;
+		}
+		while (high + 1 < count && power[high + 1] > edge)
+		{
+			high++;
+		}
+		i = std::max(i, high + 1);
+
+		if (high - low + 1 < minBins)
+		{
+			continue;
+		}
+
+		/* occupied bandwidth: trim (1-occupiedFraction)/2 of the excess power from each side */
+		double total = 0.0;
+		double bandPower = 0.0;
+		for (size_t j = low; j <= high; j++)
+		{
+			total += std::max(power[j] - noiseFloor, 0.0f);
+			bandPower += power[j];
+		}
+
+		double trim = total * (1.0 - occupiedFraction) / 2.0;
+		size_t occupiedLow = low;
+		size_t occupiedHigh = high;
+
+		for (double sum = 0.0; occupiedLow < high; occupiedLow++)
+		{
+			sum += std::max(power[occupiedLow] - noiseFloor, 0.0f);
+			if (sum > trim)
+			{
+				break;
+			}
+		}
+		for (double sum = 0.0; occupiedHigh > occupiedLow; occupiedHigh--)
+		{
+			sum += std::max(power[occupiedHigh] - noiseFloor, 0.0f);
+			if (sum > trim)
+			{
+				break;
+			}
+		}
+
+		SpectrumBand band;
+		band.CentreFrequency = ((double(occupiedLow) + double(occupiedHigh)) / 2.0 - double(count / 2)) * binWidth;
+		band.Bandwidth = double(occupiedHigh - occupiedLow + 1) * binWidth;
+		band.PowerDb = float(10.0 * std::log10(std::max(bandPower, 1e-30)));
+		bands.push_back(band);
+	}
+
+	return bands;
+}
+
+/// <summary>
+/// finds the strongest band in an IQ file
+/// </summary>
+/// <param name="iqFilePath">- path to IQ file</param>
+/// <param name="sampleRate">- sample rate of the file</param>
+/// <param name="bandOut">- strongest band, only set if true was returned</param>
+/// <returns>true if a band was found</returns>
+bool EstimateOccupiedBand(const std::string& iqFilePath, const size_t& sampleRate, SpectrumBand* bandOut)
+{
+	PowerSpectrum spectrum = WelchPowerSpectrum(iqFilePath, sampleRate);
+
+	if (spectrum.Power.empty())
+	{
+		return false;
+	}
+
+	float noiseFloor = EstimateNoiseFloor(spectrum.Power.data(), spectrum.Power.size());
+	std::vector<SpectrumBand> bands = DetectBands(spectrum.Power.data(), spectrum.Power.size(), sampleRate, noiseFloor);
+
+	if (bands.empty())
+	{
+		return false;
+	}
+
+	*bandOut = *std::max_element(bands.begin(), bands.end(), [](const SpectrumBand& left, const SpectrumBand& right) { return left.PowerDb < right.PowerDb; });
+	return true;
+}
+
+/// <summary>
+/// a transmission found by the activity scanner
+/// </summary>
+struct ActivityRecord
+{
+	double StartTime = 0.0;			/* seconds from start of file */
+	double EndTime = 0.0;
+	double CentreFrequency = 0.0;	/* relative to the middle of the capture */
+	double Bandwidth = 0.0;
+	float PowerDb = -300.0f;		/* strongest power seen */
+};
+
+/// <summary>
+/// Scans a wideband capture for transmissions.
+/// The file gets cut into time slices, each slice gets a PSD (50% overlapped FFTs averaged over the whole slice, so every sample is looked at),
+/// bands above the slice's noise floor get detected, and bands that overlap in frequency in following slices get joined up into one transmission.
+/// a burst shorter then a slice gets averaged with the rest of it, so it has to be about sliceSeconds / its length stronger to get over the threshold.
+/// slices get processed in parallel
+/// </summary>
+/// <param name="iqFilePath">- path to IQ file (complex float)</param>
+/// <param name="sampleRate">- sample rate of the file</param>
+/// <param name="fftSize">- FFT size (resolution is sampleRate/fftSize)</param>
+/// <param name="sliceSeconds">- time resolution of the waterfall</param>
+/// <param name="thresholdDb">- how far above the noise floor a band has to be</param>
+/// <param name="holdSeconds">- how long a transmission can drop out before it counts as ended</param>
+/// <param name="minSeconds">- transmissions shorter then this get dropped</param>
+/// <returns>transmissions, ordered by start time</returns>
+std::vector<ActivityRecord> ScanActivity(const std::string& iqFilePath, const size_t& sampleRate, const size_t& fftSize = 4096, const double& sliceSeconds = 0.05, const float& thresholdDb = 10.0f, const double& holdSeconds = 0.3, const double& minSeconds = 0.2)
+{
+	std::vector<ActivityRecord> records;
+
+	if (!std::filesystem::exists(iqFilePath))
+	{
+		printf("not file found at: %s\n", iqFilePath.c_str());
+		return records;
+	}
+
+	size_t sampleCount = std::filesystem::file_size(iqFilePath) / sizeof(std::complex<float>);
+	size_t sliceLength = std::max(size_t(sliceSeconds * sampleRate), fftSize);
+	size_t sliceCount = sampleCount / sliceLength;
+
+	/* waterfall: bands of every slice */
+	std::vector<std::vector<SpectrumBand>> sliceBands(sliceCount);
+	std::vector<float> window = HannWindow(fftSize);
+
+	double windowPower = 0.0;
+	for (float value : window)
+	{
+		windowPower += value * value;
+	}
+
+	ParallelFor(sliceCount, [&](size_t begin, size_t end)
+		{
+			FFT transform(fftSize);
+			std::ifstream iqStream(iqFilePath, std::ios::binary);
+			std::vector<std::complex<float>> block(sliceLength);
+			std::vector<float> real(fftSize), imag(fftSize), power(fftSize);
+
+			for (size_t slice = begin; slice < end; slice++)
+			{
+				iqStream.seekg(slice * sliceLength * sizeof(std::complex<float>), std::ios::beg);
+				iqStream.read(reinterpret_cast<char*>(block.data()), sliceLength * sizeof(std::complex<float>));
+
+				std::fill(power.begin(), power.end(), 0.0f);
+				size_t segments = 0;
+				for (size_t offset = 0; offset + fftSize <= sliceLength; offset += fftSize / 2)
+				{
+					AccumulatePowerSpectrum(transform, window, block.data() + offset, real.data(), imag.data(), power.data());
+					segments++;
+				}
+
+				float scale = float(1.0 / (double(segments) * double(fftSize) * windowPower));
+				for (float& value : power)
+				{
+					value *= scale;
+				}
+
+				sliceBands[slice] = DetectBands(power.data(), fftSize, sampleRate, EstimateNoiseFloor(power.data(), fftSize), thresholdDb);
+			}
+		});
+
+	/* join bands up into transmissions */
+	struct OpenRecord
+	{
+		ActivityRecord Record;
+		size_t LastSlice;	/* last slice a band got joined onto it, a record takes at most one band per slice */
+		double WeightedCentre;
+		double Weight;
+	};
+
+	std::vector<OpenRecord> open;
+	size_t holdSlices = size_t(holdSeconds / (double(sliceLength) / double(sampleRate)));
+
+	auto closeRecord = [&](OpenRecord& openRecord)
+		{
+			openRecord.Record.CentreFrequency = openRecord.WeightedCentre / openRecord.Weight;
+			if (openRecord.Record.EndTime - openRecord.Record.StartTime >= minSeconds)
+			{
+				records.push_back(openRecord.Record);
+			}
+		};
+
+	for (size_t slice = 0; slice < sliceCount; slice++)
+	{
+		double sliceStart = double(slice * sliceLength) / double(sampleRate);
+		double sliceEnd = double((slice + 1) * sliceLength) / double(sampleRate);
+
+		for (const SpectrumBand& band : sliceBands[slice])
+		{
+			OpenRecord* match = nullptr;
+			for (OpenRecord& openRecord : open)
+			{
+				if (openRecord.LastSlice == slice)
+				{
+					continue;
+				}
+
+				double openCentre = openRecord.WeightedCentre / openRecord.Weight;
+				if (std::abs(band.CentreFrequency - openCentre) <= (band.Bandwidth + openRecord.Record.Bandwidth) / 2.0)
+				{
+					match = &openRecord;
+					break;
+				}
+			}
+
+			if (match == nullptr)
+			{
+				open.push_back(OpenRecord{ActivityRecord{sliceStart, sliceEnd, band.CentreFrequency, band.Bandwidth, band.PowerDb}, slice, 0.0, 0.0});
+				match = &open.back();
+			}
+
+			/* centre is averaged (weighted by power), the rest are the extremes */
+			double weight = std::pow(10.0, band.PowerDb / 10.0);
+			match->WeightedCentre += band.CentreFrequency * weight;
+			match->Weight += weight;
+			match->Record.EndTime = sliceEnd;
+			match->Record.Bandwidth = std::max(match->Record.Bandwidth, band.Bandwidth);
+			match->Record.PowerDb = std::max(match->Record.PowerDb, band.PowerDb);
+			match->LastSlice = slice;
+		}
+
+		/* close transmissions that have been gone for longer then the hold time */
+		for (size_t i = 0; i < open.size();)
+		{
+			if (slice - open[i].LastSlice > holdSlices)
+			{
+				closeRecord(open[i]);
+				open.erase(open.begin() + i);
+				continue;
+			}
+			i++;
+		}
+	}
+
+	for (OpenRecord& openRecord : open)
+	{
+		closeRecord(openRecord);
+	}
+
+	std::sort(records.begin(), records.end(), [](const ActivityRecord& left, const ActivityRecord& right) { return left.StartTime < right.StartTime; });
+	return records;
+}
+
+/// <summary>
+/// prints the activity table and writes it to a CSV file
+/// </summary>
+/// <param name="filePath">- CSV file to write to</param>
+/// <param name="records">- transmissions</param>
+void WriteActivityTable(const std::filesystem::path& filePath, const std::vector<ActivityRecord>& records)
+{
+	std::ofstream tableStream(filePath, std::ios::trunc);
+	tableStream << "start_s,end_s,centre_hz,bandwidth_hz,power_db\n";
+
+	printf("%10s %10s %12s %12s %9s\n", "Start(s)", "End(s)", "Centre(Hz)", "Bandwidth", "Power(dB)");
+
+	char line[128];
+	for (const ActivityRecord& record : records)
+	{
+		printf("%10.2f %10.2f %12.0f %12.0f %9.1f\n", record.StartTime, record.EndTime, record.CentreFrequency, record.Bandwidth, record.PowerDb);
+
+		snprintf(line, sizeof(line), "%.3f,%.3f,%.0f,%.0f,%.1f\n", record.StartTime, record.EndTime, record.CentreFrequency, record.Bandwidth, record.PowerDb);
+		tableStream << line;
+	}
+
+	tableStream.close();
+}
@@ -0,0 +1,436 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+
+#include "AudioTranscribing.hpp"
+
+/* Streaming (seconds) */
+const double DefaultStreamLatencyTarget = 4.0;	/* how long after an utterance ends its transcript should be out */
+const double StreamWindowLength = 15.0;			/* longest window, longer speech gets committed in pieces */
+const double StreamKeepLength = 0.2;			/* carried over into the next window when a full window gets committed, so a word on the edge isn't lost */
+const double StreamSpeechEndHold = 0.8;			/* silence after speech before an utterance counts as finished */
+const double StreamMinStep = 0.5;				/* shortest time between decodes */
+const double StreamMinDecodeLength = 1.1;		/* whisper skips anything under a second, shorter windows get padded with silence */
+const double StreamVoiceFrame = 0.02;			/* frame length of the voice detection */
+
+/* Voice detection */
+const float StreamVoiceLevel = 0.02f;				/* frames quieter then this (rms) count as silence */
+const float StreamVoiceDifferenceRatio = 0.7f;		/* energy of the first difference over the energy of the frame, over this is noise */
+
+/// <summary>
+/// voice detection for demodulated FM. when the squelch is closed the discriminator puts out noise which rises with frequency,
+/// its first difference has more energy then the noise itself. voice is band limited to ~3KHz, so its first difference has a lot less (~0.15 at 1KHz).
+/// (the same idea as SpectralNoiseReducer's high band squelch, without needing a whole STFT frame)
+/// </summary>
+/// <param name="data">- audio</param>
+/// <param name="count">- amount of samples</param>
+/// <returns>true if the frame has voice in it</returns>
+inline bool IsVoiceFrame(const float* data, const size_t& count)
+{
+	double energy = 0.0;
+	double differenceEnergy = 0.0;
+
+	for (size_t i = 1; i < count; i++)
+	{
+		double difference = double(data[i]) - data[i - 1];
+		energy += double(data[i]) * data[i];
+		differenceEnergy += difference * difference;
+	}
+
+	return count > 1 && std::sqrt(energy / double(count - 1)) > StreamVoiceLevel && differenceEnergy < StreamVoiceDifferenceRatio * energy;
+}
+
+/// <summary>
+/// Transcribes a live audio stream with a sliding window (like whisper.cpp's stream example).
+/// audio gets pushed in as it arrives, a worker thread decodes the window every step and prints the tentative text,
+/// the text gets committed once the speech in the window ends (or the window is full), then the window starts over.
+/// the step comes from the latency target: an utterance waits at most one step for the next decode, which itself has to fit in a step
+/// </summary>
+class StreamingTranscriber
+{
+public:
+	/// <summary>
+	/// loads the model (if it isn't already) and starts the worker
+	/// </summary>
+	/// <param name="modelPath">- path to model used for transcribing</param>
+	/// <param name="committed">- gets every committed segment (on the worker thread), can be empty</param>
+	/// <param name="latencyTarget">- seconds after the end of speech by which its transcript should be out</param>
+	/// <param name="language">- language of the audio</param>
+	/// <param name="threadCount">- threads used by whisper</param>
+	/// <param name="translate">- translate into english, otherwise transcribe in the spoken language</param>
+	StreamingTranscriber(const std::string& modelPath, std::function<void(const TranscriptSegment&)> committed = nullptr, const double& latencyTarget = DefaultStreamLatencyTarget,
+		const std::string& language = "auto", const int& threadCount = std::thread::hardware_concurrency(), const bool& translate = true)
+	{
+		Committed = std::move(committed);
+		LatencyTarget = latencyTarget;
+		Language = language;
+		ThreadCount = threadCount;
+		Translate = translate;
+		Step = std::max((latencyTarget - StreamSpeechEndHold) / 2.0, StreamMinStep);
+
+		if (!LoadWhisperContext(modelPath))
+		{
+			return;
+		}
+
+		State = whisper_init_state(ctx);
+		if (State == nullptr)
+		{
+			fprintf(stderr, "error: failed to create whisper state\n");
+			return;
+		}
+
+		printf("streaming: decoding every %.2f sec, windows up to %.0f sec, latency target %.1f sec\n", Step, StreamWindowLength, LatencyTarget);
+		Worker = std::thread(&StreamingTranscriber::WorkerLoop, this);
+	}
+
+	StreamingTranscriber(const StreamingTranscriber&) = delete;
+	StreamingTranscriber& operator=(const StreamingTranscriber&) = delete;
+
+	~StreamingTranscriber()
+	{
+		Finish();
+
+		if (State != nullptr)
+		{
+			whisper_free_state(State);
+		}
+	}
+
+	bool IsLoaded()
+	{
+		return State != nullptr;
+	}
+
+	/// <summary>
+	/// adds audio (WHISPER_SAMPLE_RATE) as it arrives, never waits on whisper
+	/// </summary>
+	/// <param name="data">- audio</param>
+	/// <param name="count">- amount of samples</param>
+	void Push(const float* data, const size_t& count)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(StreamMutex);
+			Incoming.insert(Incoming.end(), data, data + count);
+			PushedCount += count;
+			Arrivals.push_back({ PushedCount, std::chrono::steady_clock::now() });
+		}
+		AudioReady.notify_one();
+	}
+
+	/// <summary>
+	/// commits whatever is left (call at the end of the stream) and stops the worker
+	/// </summary>
+	void Finish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(StreamMutex);
+			Stopping = true;
+		}
+		AudioReady.notify_one();
+
+		if (Worker.joinable())
+		{
+			Worker.join();
+		}
+	}
+
+	/// <summary>
+	/// seconds between decodes
+	/// </summary>
+	double GetStep()
+	{
+		return Step;
+	}
+
+	/// <summary>
+	/// average time from the end of speech to its transcript being committed (seconds), 0 if nothing was committed yet
+	/// </summary>
+	double GetAverageLatency()
+	{
+		std::lock_guard<std::mutex> lock(StreamMutex);
+		return LatencyCount == 0 ? 0.0 : LatencySum / double(LatencyCount);
+	}
+
+private:
+	struct Arrival
+	{
+		size_t End;										/* sample count pushed once this chunk was in */
+		std::chrono::steady_clock::time_point Time;
+	};
+
+	std::function<void(const TranscriptSegment&)> Committed;
+	double LatencyTarget;
+	std::string Language;
+	int ThreadCount;
+	bool Translate;
+	double Step;
+
+	whisper_state* State = nullptr;
+	std::thread Worker;
+
+	/* shared with Push, guarded by StreamMutex */
+	std::mutex StreamMutex;
+	std::condition_variable AudioReady;
+	std::vector<float> Incoming;
+	std::deque<Arrival> Arrivals;
+	size_t PushedCount = 0;
+	bool Stopping = false;
+	double LatencySum = 0.0;
+	size_t LatencyCount = 0;
+
+	/* worker only */
+	std::vector<float> Window;
+	size_t WindowStart = 0;			/* stream position (samples) of Window[0] */
+	size_t ScannedCount = 0;		/* samples of Window the voice detection went over */
+	bool HasVoice = false;
+	size_t LastVoiceEnd = 0;		/* stream position just after the last voice frame */
+	size_t UtteranceCut = 0;		/* where in the window the utterance that just ended gets cut off */
+	std::chrono::steady_clock::time_point LastVoiceArrival;
+	std::string Prompt;				/* end of the committed text, keeps the next window consistent with it */
+	size_t TentativeLength = 0;		/* length of the tentative line on screen */
+
+	void WorkerLoop()
+	{
+		const size_t stepSamples = size_t(Step * WHISPER_SAMPLE_RATE);
+		const size_t maxWindow = size_t(StreamWindowLength * WHISPER_SAMPLE_RATE);
+		const size_t keepSamples = size_t(StreamKeepLength * WHISPER_SAMPLE_RATE);
+
+		while (true)
+		{
+			bool finalPass;
+
+			{
+				std::unique_lock<std::mutex> lock(StreamMutex);
+				AudioReady.wait(lock, [&] { return Incoming.size() >= stepSamples || Stopping; });
+
+				/* after a long decode more then a window can be waiting, it gets worked through a window at a time */
+				size_t take = std::min(Incoming.size(), maxWindow - Window.size());
+				Window.insert(Window.end(), Incoming.begin(), Incoming.begin() + take);
+				Incoming.erase(Incoming.begin(), Incoming.begin() + take);
+				finalPass = Stopping && Incoming.empty();
+			}
+
+			/* every utterance that ended somewhere in the new audio gets committed on its own, up to where it ended */
+			while (ScanVoice())
+			{
+				Commit(Decode(UtteranceCut));
+				DropFront(UtteranceCut);
+				ResetVoice();
+			}
+
+			if (!HasVoice)
+			{
+				/* nothing said yet, only keep the end in case a word is just starting */
+				DropFront(Window.size() > keepSamples ? Window.size() - keepSamples : 0);
+			}
+			else if (Window.size() >= maxWindow || finalPass)
+			{
+				/* speech still going, the end of the window gets carried over so the word on the edge isn't lost */
+				Commit(Decode(Window.size()));
+				DropFront(finalPass ? Window.size() : Window.size() - keepSamples);
+				ResetVoice();
+			}
+			else
+			{
+				ShowTentative(Decode(Window.size()));
+			}
+
+			if (finalPass)
+			{
+				break;
+			}
+		}
+	}
+
+	/// <summary>
+	/// runs voice detection over the new part of the window, stops at the end of an utterance
+	/// </summary>
+	/// <returns>true if an utterance ended, UtteranceCut is then where the window should be cut</returns>
+	bool ScanVoice()
+	{
+		const size_t frameLength = size_t(StreamVoiceFrame * WHISPER_SAMPLE_RATE);
+		const size_t holdSamples = size_t(StreamSpeechEndHold * WHISPER_SAMPLE_RATE);
+
+		std::lock_guard<std::mutex> lock(StreamMutex); /* for the arrival times */
+
+		for (; ScannedCount + frameLength <= Window.size(); ScannedCount += frameLength)
+		{
+			if (!IsVoiceFrame(Window.data() + ScannedCount, frameLength))
+			{
+				if (HasVoice && WindowStart + ScannedCount + frameLength - LastVoiceEnd >= holdSamples)
+				{
+					/* cut half way into the silence, so the last word keeps its tail */
+					UtteranceCut = LastVoiceEnd - WindowStart + holdSamples / 2;
+					ScannedCount += frameLength;
+					return true;
+				}
+				continue;
+			}
+
+			HasVoice = true;
+			LastVoiceEnd = WindowStart + ScannedCount + frameLength;
+
+			for (const Arrival& arrival : Arrivals)
+			{
+				if (arrival.End >= LastVoiceEnd)
+				{
+					LastVoiceArrival = arrival.Time;
+					break;
+				}
+			}
+		}
+
+		while (!Arrivals.empty() && Arrivals.front().End <= WindowStart + ScannedCount)
+		{
+			Arrivals.pop_front();
+		}
+
+		return false;
+	}
+
+	/// <summary>
+	/// starts voice detection over, for what is left of the window after a commit
+	/// </summary>
+	void ResetVoice()
+	{
+		HasVoice = false;
+		ScannedCount = 0;
+	}
+
+	/// <summary>
+	/// removes samples from the start of the window
+	/// </summary>
+	void DropFront(const size_t& count)
+	{
+		Window.erase(Window.begin(), Window.begin() + count);
+		WindowStart += count;
+		ScannedCount = ScannedCount > count ? ScannedCount - count : 0;
+	}
+
+	/// <summary>
+	/// decodes the start of the window
+	/// </summary>
+	/// <param name="count">- amount of samples to decode</param>
+	/// <returns>segments, times from the start of the stream</returns>
+	std::vector<TranscriptSegment> Decode(const size_t& count)
+	{
+		std::vector<float> samples(Window.begin(), Window.begin() + count);
+		samples.resize(std::max(samples.size(), size_t(StreamMinDecodeLength * WHISPER_SAMPLE_RATE)), 0.0f);
+
+		whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+
+		wparams.print_realtime = false;
+		wparams.print_progress = false;
+		wparams.language = Language.c_str();
+		wparams.translate = Translate;
+		wparams.n_threads = ThreadCount;
+		wparams.no_context = true; /* the committed text goes in through the prompt instead */
+		wparams.initial_prompt = Prompt.empty() ? nullptr : Prompt.c_str();
+
+		std::vector<TranscriptSegment> segments;
+
+		if (whisper_full_with_state(ctx, State, wparams, samples.data(), int(samples.size())) != 0)
+		{
+			fprintf(stderr, "failed to process audio\n");
+			return segments;
+		}
+
+		double windowTime = double(WindowStart) / WHISPER_SAMPLE_RATE;
+		double windowEnd = double(WindowStart + count) / WHISPER_SAMPLE_RATE;
+
+		/* whisper timestamps are in 10ms units */
+		const int segmentCount = whisper_full_n_segments_from_state(State);
+		for (int i = 0; i < segmentCount; i++)
+		{
+			TranscriptSegment segment;
+			segment.StartTime = windowTime + double(whisper_full_get_segment_t0_from_state(State, i)) / 100.0;
+			segment.EndTime = std::min(windowTime + double(whisper_full_get_segment_t1_from_state(State, i)) / 100.0, windowEnd);
+			segment.Text = whisper_full_get_segment_text_from_state(State, i);
+			segments.push_back(segment);
+		}
+
+		return segments;
+	}
+
+	/// <summary>
+	/// prints the current guess on one line, which gets overwritten by the next one
+	/// </summary>
+	void ShowTentative(const std::vector<TranscriptSegment>& segments)
+	{
+		std::string text;
+		for (const TranscriptSegment& segment : segments)
+		{
+			text += segment.Text;
+		}
+
+		std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+		printf("\r%*s\r...%s", int(TentativeLength), "", text.c_str());
+		fflush(stdout);
+		TentativeLength = text.size() + 3;
+	}
+
+	/// <summary>
+	/// prints and hands over the final text of the window
+	/// </summary>
+	void Commit(const std::vector<TranscriptSegment>& segments)
+	{
+		double latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - LastVoiceArrival).count();
+
+		{
+			std::lock_guard<std::mutex> lock(StreamMutex);
+			LatencySum += latency;
+			LatencyCount++;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(WhisperPrintMutex);
+			printf("\r%*s\r", int(TentativeLength), "");
+			TentativeLength = 0;
+
+			for (const TranscriptSegment& segment : segments)
+			{
+				printf("[%s --> %s]  %s\n", to_timestamp(int64_t(segment.StartTime * 100.0 + 0.5)).c_str(), to_timestamp(int64_t(segment.EndTime * 100.0 + 0.5)).c_str(), segment.Text.c_str());
+			}
+
+			if (latency > LatencyTarget)
+			{
+				printf("(committed %.1f sec after the speech, over the %.1f sec target, whisper can't keep up, try a smaller model or more threads)\n", latency, LatencyTarget);
+			}
+			fflush(stdout);
+		}
+
+		for (const TranscriptSegment& segment : segments)
+		{
+			Prompt += segment.Text;
+
+			if (Committed)
+			{
+				Committed(segment);
+			}
+		}
+
+		/* only the end of what was said is useful as context */
+		const size_t maxPrompt = 200;
+		if (Prompt.size() > maxPrompt)
+		{
+			size_t cut = Prompt.find(' ', Prompt.size() - maxPrompt); /* on a word boundary, so no UTF-8 character gets split */
+			Prompt.erase(0, cut == std::string::npos ? Prompt.size() - maxPrompt : cut);
+		}
+	}
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <optional>
+#include <cstdio>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+const char* const ThreadTuningFile = "lvatt-tuning.txt"; /* next to the downloaded models, one line per host, model and decoding profile */
+
+/// <summary>
+/// how the threads get used for transcribing, amount of batches at once (whisper states) and threads each of those gets
+/// </summary>
+struct ThreadConfiguration
+{
+	size_t JobSlots = 1;
+	int ThreadsPerJob = 1;
+};
+
+/// <summary>
+/// name of this machine, tuning is kept per host as the same setup is shared between different machines
+/// </summary>
+inline std::string GetHostName()
+{
+#ifdef _WIN32
+	char name[MAX_COMPUTERNAME_LENGTH + 1];
+	DWORD size = sizeof(name);
+	if (GetComputerNameA(name, &size))
+	{
+		return std::string(name, size);
+	}
+#else
+	char name[256] = {};
+	if (gethostname(name, sizeof(name) - 1) == 0)
+	{
+		return name;
+	}
+#endif
+
+	return "unknown";
+}
+
+/// <summary>
+/// what a model gets saved under, its file name and size (so a different file with the same name gets tuned again)
+/// </summary>
+/// <param name="modelPath">- path to model</param>
+inline std::string ModelTuningKey(const std::string& modelPath)
+{
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(modelPath, error);
+
+	return std::filesystem::path(modelPath).filename().string() + ":" + std::to_string(error ? 0 : size);
+}
+
+/// <summary>
+/// start of the line a configuration gets saved on, host \t model \t profile \t (job slots and threads per job follow)
+/// </summary>
+/// <param name="modelPath">- path to model</param>
+/// <param name="profileName">- decoding profile, beam search and best of change how much work a batch is so they get tuned separately</param>
+inline std::string ThreadTuningPrefix(const std::string& modelPath, const std::string& profileName)
+{
+	return GetHostName() + "\t" + ModelTuningKey(modelPath) + "\t" + profileName + "\t";
+}
+
+/// <summary>
+/// looks up the saved configuration of this host, model and decoding profile
+/// </summary>
+/// <param name="modelPath">- path to model</param>
+/// <param name="profileName">- decoding profile</param>
+/// <returns>configuration, nothing if it hasn't been tuned yet</returns>
+std::optional<ThreadConfiguration> LoadThreadConfiguration(const std::string& modelPath, const std::string& profileName)
+{
+	std::ifstream tuningStream(ThreadTuningFile);
+	std::string prefix = ThreadTuningPrefix(modelPath, profileName);
+
+	for (std::string line; std::getline(tuningStream, line);)
+	{
+		if (line.compare(0, prefix.size(), prefix) != 0)
+		{
+			continue;
+		}
+
+		ThreadConfiguration configuration;
+		if (2 == sscanf(line.c_str() + prefix.size(), "%zu %d", &configuration.JobSlots, &configuration.ThreadsPerJob) && configuration.JobSlots > 0 && configuration.ThreadsPerJob > 0)
+		{
+			return configuration;
+		}
+	}
+
+	return std::nullopt;
+}
+
+/// <summary>
+/// saves the configuration of this host, model and decoding profile, replacing the one saved before.
+/// the file gets written under a temporary name and renamed over the old one, so other LVATT processes on the host never read half of it
+/// </summary>
+/// <param name="modelPath">- path to model</param>
+/// <param name="profileName">- decoding profile</param>
+/// <param name="configuration">- configuration to save</param>
+void SaveThreadConfiguration(const std::string& modelPath, const std::string& profileName, const ThreadConfiguration& configuration)
+{
+	std::string prefix = ThreadTuningPrefix(modelPath, profileName);
+
+	std::vector<std::string> lines;
+	{
+		std::ifstream tuningStream(ThreadTuningFile);
+		for (std::string line; std::getline(tuningStream, line);)
+		{
+			if (!line.empty() && line.compare(0, prefix.size(), prefix) != 0)
+			{
+				lines.push_back(line);
+			}
+		}
+	}
+	lines.push_back(prefix + std::to_string(configuration.JobSlots) + "\t" + std::to_string(configuration.ThreadsPerJob));
+
+	/* own temporary file per process, so two processes saving at once don't write into the same one */
+#ifdef _WIN32
+	std::filesystem::path tempPath = std::string(ThreadTuningFile) + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+#else
+	std::filesystem::path tempPath = std::string(ThreadTuningFile) + "." + std::to_string(getpid()) + ".tmp";
+#endif
+
+	bool written;
+	{
+		std::ofstream tuningStream(tempPath, std::ios::trunc);
+		for (const std::string& line : lines)
+		{
+			tuningStream << line << "\n";
+		}
+
+		tuningStream.close();
+		written = !tuningStream.fail();
+	}
+
+	std::error_code error;
+	if (written)
+	{
+		std::filesystem::rename(tempPath, ThreadTuningFile, error);
+		if (error)
+		{
+			/* rename doesn't replace existing files on every platform */
+			std::filesystem::remove(ThreadTuningFile, error);
+			std::filesystem::rename(tempPath, ThreadTuningFile, error);
+		}
+	}
+
+	if (!written || error)
+	{
+		printf("failed to save thread tuning to %s\n", ThreadTuningFile);
+		std::filesystem::remove(tempPath, error);
+	}
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+
+#include "AudioTranscribing.hpp"
+#include "ClipExport.hpp"
+#include "OutputService.hpp"
+
+/// <summary>
+/// which transcript files get written next to the audio
+/// </summary>
+struct TranscriptFormats
+{
+	bool Srt = false;
+	bool Vtt = false;
+	bool Json = false;	/* segments with their tokens (times and probabilities) and the language */
+
+	bool Any() const
+	{
+		return Srt || Vtt || Json;
+	}
+};
+
+/// <summary>
+/// segment text without the space whisper starts it with
+/// </summary>
+inline std::string SegmentText(const TranscriptSegment& segment)
+{
+	size_t first = segment.Text.find_first_not_of(' ');
+	return first == std::string::npos ? std::string() : segment.Text.substr(first);
+}
+
+/* seconds into whisper's 10ms units, for to_timestamp */
+inline int64_t ToCentiseconds(const double& seconds)
+{
+	return int64_t(seconds * 100.0 + 0.5);
+}
+
+/// <summary>
+/// writes SubRip subtitles
+/// </summary>
+/// <param name="filePath">- path to the file</param>
+/// <param name="segments">- transcribed segments</param>
+void WriteSrt(const std::filesystem::path& filePath, const std::vector<TranscriptSegment>& segments)
+{
+	std::ofstream outStream(filePath, std::ios::binary | std::ios::trunc);
+	if (!outStream.is_open())
+	{
+		printf("failed to open %s\n", filePath.string().c_str());
+		return;
+	}
+
+	int cueNumber = 1;
+	for (const TranscriptSegment& segment : segments)
+	{
+		outStream << cueNumber++ << "\n"
+			<< to_timestamp(ToCentiseconds(segment.StartTime), true) << " --> " << to_timestamp(ToCentiseconds(segment.EndTime), true) << "\n"
+			<< SegmentText(segment) << "\n\n";
+	}
+}
+
+/// <summary>
+/// writes WebVTT subtitles
+/// </summary>
+/// <param name="filePath">- path to the file</param>
+/// <param name="segments">- transcribed segments</param>
+void WriteVtt(const std::filesystem::path& filePath, const std::vector<TranscriptSegment>& segments)
+{
+	std::ofstream outStream(filePath, std::ios::binary | std::ios::trunc);
+	if (!outStream.is_open())
+	{
+		printf("failed to open %s\n", filePath.string().c_str());
+		return;
+	}
+
+	outStream << "WEBVTT\n\n";
+	for (const TranscriptSegment& segment : segments)
+	{
+		outStream << to_timestamp(ToCentiseconds(segment.StartTime)) << " --> " << to_timestamp(ToCentiseconds(segment.EndTime)) << "\n"
+			<< SegmentText(segment) << "\n\n";
+	}
+}
+
+/// <summary>
+/// writes the transcript as JSON, with everything whisper gave back for it (token times and probabilities, language),
+/// for tools that ingest transcripts instead of reading them
+/// </summary>
+/// <param name="filePath">- path to the file</param>
+/// <param name="source">- file the transcript is of</param>
+/// <param name="segments">- transcribed segments</param>
+void WriteTranscriptJson(const std::filesystem::path& filePath, const std::string& source, const std::vector<TranscriptSegment>& segments)
+{
+	std::ofstream outStream(filePath, std::ios::binary | std::ios::trunc);
+	if (!outStream.is_open())
+	{
+		printf("failed to open %s\n", filePath.string().c_str());
+		return;
+	}
+
+	/* every batch detects its own language, the file gets the one most segments were decoded as */
+	std::map<std::string, size_t> languageCounts;
+	std::string language;
+	for (const TranscriptSegment& segment : segments)
+	{
+		size_t count = ++languageCounts[segment.Language];
+		if (count > languageCounts[language])
+		{
+			language = segment.Language;
+		}
+	}
+
+	outStream << "{\"source\":\"" << JsonEscape(source) << "\",\"language\":\"" << JsonEscape(language) << "\",\"segments\":[";
+
+	char numbers[96];
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		const TranscriptSegment& segment = segments[i];
+
+		snprintf(numbers, sizeof(numbers), "\"start\":%.2f,\"end\":%.2f", segment.StartTime, segment.EndTime);
+		outStream << (i == 0 ? "" : ",") << "\n{" << numbers << ",\"language\":\"" << JsonEscape(segment.Language)
+			<< "\",\"text\":\"" << JsonEscape(SegmentText(segment)) << "\",\"tokens\":[";
+
+		for (size_t j = 0; j < segment.Tokens.size(); j++)
+		{
+			const TranscriptToken& token = segment.Tokens[j];
+
+			snprintf(numbers, sizeof(numbers), "\"start\":%.2f,\"end\":%.2f,\"p\":%.4f", token.StartTime, token.EndTime, token.Probability);
+			outStream << (j == 0 ? "" : ",") << "{\"text\":\"" << JsonEscape(token.Text) << "\"," << numbers << "}";
+		}
+
+		outStream << "]}";
+	}
+
+	outStream << "\n]}\n";
+}
+
+/// <summary>
+/// queues the transcript files of a file to be written on the output thread, from segments that have already been decoded
+/// </summary>
+/// <param name="output">- output service</param>
+/// <param name="filePath">- path to the files, without the extension</param>
+/// <param name="source">- file the transcript is of</param>
+/// <param name="segments">- transcribed segments, moved into the task</param>
+/// <param name="formats">- files to write</param>
+void SubmitTranscriptWrite(OutputService& output, const std::filesystem::path& filePath, const std::string& source, std::vector<TranscriptSegment>&& segments, const TranscriptFormats& formats)
+{
+	if (!formats.Any())
+	{
+		return;
+	}
+
+	output.Submit([filePath, source, segments = std::move(segments), formats]()
+		{
+			if (formats.Srt)
+			{
+				WriteSrt(std::filesystem::path(filePath.string() + ".srt"), segments);
+			}
+			if (formats.Vtt)
+			{
+				WriteVtt(std::filesystem::path(filePath.string() + ".vtt"), segments);
+			}
+			if (formats.Json)
+			{
+				WriteTranscriptJson(std::filesystem::path(filePath.string() + ".json"), source, segments);
+			}
+		});
+}
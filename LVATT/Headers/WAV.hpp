@@ -3,185 +3,675 @@
 #include <filesystem>
 #include <fstream>
 #include <bitset>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <bit>
+#include <algorithm>
+#include <stdexcept>
 
 #include "../NosLib/Byte.hpp"
 
 #include "Common.hpp"
+#include "MappedFile.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LVATT_SSE2
+#endif
+
+/// <summary>
+/// puts a number into a little endian byte array
+/// </summary>
+/// <param name="dest">- where to write the bytes</param>
+/// <param name="value">- number</param>
+/// <param name="byteCount">- how many bytes the number takes up</param>
+inline void PutLittleEndian(char* dest, const uint64_t& value, const size_t& byteCount)
+{
+	for (size_t i = 0; i < byteCount; i++)
+	{
+		dest[i] = char((value >> (i * 8)) & 0xFF);
+	}
+}
+
+/* float to short array, with saturation (out of range samples get clipped instead of wrapping around) */
+inline void f2s_array(const float* src, int16_t* dest, const size_t& count, int normalize)
+{
+	const float normfact = normalize ? (1.0f * 0x7FFF) : 1.0f;
+	size_t i = 0;
+
+#ifdef LVATT_SSE2
+	/* 8 samples at a time: scale, clamp, round (same rounding as lrintf) and pack down to 16 bit */
+	const __m128 scale = _mm_set1_ps(normfact);
+	const __m128 maxValue = _mm_set1_ps(32767.0f);
+	const __m128 minValue = _mm_set1_ps(-32768.0f);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128 low = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+		__m128 high = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+
+		low = _mm_max_ps(_mm_min_ps(low, maxValue), minValue);
+		high = _mm_max_ps(_mm_min_ps(high, maxValue), minValue);
+
+		__m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), packed);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float value = std::clamp(src[i] * normfact, -32768.0f, 32767.0f);
+		dest[i] = int16_t(lrintf(value));
+	}
+}
+
+/* float to little endian short array, with saturation */
+inline void f2les_array(const float* src, int16_t* dest, const size_t& count, int normalize)
+{
+	f2s_array(src, dest, count, normalize);
+
+	if constexpr (std::endian::native == std::endian::big)
+	{
+		for (size_t j = 0; j < count; j++)
+		{
+			uint16_t value = uint16_t(dest[j]);
+			dest[j] = int16_t((value >> 8) | (value << 8));
+		}
+	}
+}
+
+/* amount of samples converted and written at once */
+const size_t WavWriteBlockSize = 1 << 16;
+
+/* size of the ds64 chunk's data (RIFF size, data size, sample count and an empty table) */
+const uint32_t Ds64Size = 28;
+
+/// <summary>
+/// writes the sizes into a RIFF/RF64 header. if the file doesn't fit into 32 bit sizes, it gets turned into RF64 (EBU Tech 3306):
+/// RIFF becomes RF64, the reserved JUNK chunk becomes ds64 with the 64 bit sizes, and the 32 bit sizes get set to 0xFFFFFFFF
+/// </summary>
+/// <param name="header">- start of the file (at least up to the end of the ds64/JUNK chunk)</param>
+/// <param name="ds64Position">- where the reserved JUNK chunk is (0 if there isn't one)</param>
+/// <param name="dataSize">- the data chunk's size field</param>
+/// <param name="dataSizePosition">- where the data chunk's size field is in the file</param>
+/// <param name="dataBytes">- size of the audio</param>
+/// <param name="blockAlign">- bytes per sample frame</param>
+/// <returns>false if the file needs RF64 but there is no room for ds64</returns>
+inline bool FillRiffSizes(char* header, const uint64_t& ds64Position, char* dataSize, const uint64_t& dataSizePosition, const uint64_t& dataBytes, const uint16_t& blockAlign)
+{
+	uint64_t riffSize = dataSizePosition + 4 + dataBytes - 8;
+
+	if (riffSize <= 0xFFFFFFFF)
+	{
+		memcpy(header + 0, "RIFF", 4);
+		PutLittleEndian(header + 4, riffSize, 4);
+		PutLittleEndian(dataSize, dataBytes, 4);
+
+		if (ds64Position != 0)
+		{
+			memcpy(header + ds64Position, "JUNK", 4);
+		}
+		return true;
+	}
+
+	if (ds64Position == 0)
+	{
+		return false;
+	}
+
+	memcpy(header + 0, "RF64", 4);
+	PutLittleEndian(header + 4, 0xFFFFFFFF, 4);
+	PutLittleEndian(dataSize, 0xFFFFFFFF, 4);
+
+	char* ds64 = header + ds64Position;
+	memcpy(ds64, "ds64", 4);
+	PutLittleEndian(ds64 + 4, Ds64Size, 4);
+	PutLittleEndian(ds64 + 8, riffSize, 8);
+	PutLittleEndian(ds64 + 16, dataBytes, 8);
+	PutLittleEndian(ds64 + 24, dataBytes / blockAlign, 8);
+	PutLittleEndian(ds64 + 32, 0, 4);
+	return true;
+}
+
+/// <summary>
+/// Streaming WAV writer. Writes a header with placeholder sizes, appends audio as it gets made, and patches the sizes in on Close.
+/// the sizes also get patched in every so often while writing, so if the program gets killed the file is still readable up to the last patch (and RecoverWav can fix the rest).
+/// a JUNK chunk is reserved after the RIFF header, so once the audio goes over 4GB the file turns into RF64 without having to move anything
+/// </summary>
+class WavWriter
+{
+public:
+	static constexpr uint16_t BitsPerSample = 16;
+	static constexpr size_t Ds64Position = 12;
+	static constexpr size_t FmtPosition = Ds64Position + 8 + Ds64Size;
+	static constexpr size_t DataPosition = FmtPosition + 8 + 16;
+	static constexpr size_t HeaderSize = DataPosition + 8;
+	static constexpr uint64_t HeaderRefreshBytes = 1 << 22; /* 4MB */
+
+	/// <summary>
+	/// creates file and writes placeholder header
+	/// </summary>
+	/// <param name="filePath">- path to the WAV file</param>
+	/// <param name="channels">- channel count</param>
+	/// <param name="sampleRate">- sample rate</param>
+	WavWriter(const std::filesystem::path& filePath, const uint16_t& channels, const uint32_t& sampleRate)
+	{
+		Channels = channels;
+		SampleRate = sampleRate;
+
+		WavStream.open(filePath, std::ios::binary | std::ios::trunc | std::ios::out);
+
+		char header[HeaderSize];
+		FillHeader(header, 0);
+		WavStream.write(header, HeaderSize);
+	}
+
+	~WavWriter()
+	{
+		Close();
+	}
+
+	bool IsOpen()
+	{
+		return WavStream.is_open();
+	}
+
+	/// <summary>
+	/// appends audio (interleaved if more then 1 channel)
+	/// </summary>
+	/// <param name="data">- audio</param>
+	/// <param name="count">- amount of samples</param>
+	void Write(const float* data, const size_t& count)
+	{
+		if (!IsOpen())
+		{
+			return;
+		}
+
+		Buffer.resize(std::min(count, WavWriteBlockSize));
+
+		/* convert and write in big blocks, instead of a stream call per sample */
+		for (size_t offset = 0; offset < count; offset += WavWriteBlockSize)
+		{
+			size_t blockCount = std::min(WavWriteBlockSize, count - offset);
+
+			f2les_array(data + offset, Buffer.data(), blockCount, 1);
+			WavStream.write(reinterpret_cast<char*>(Buffer.data()), blockCount * sizeof(int16_t));
+		}
+
+		AddWritten(count);
+	}
+
+	/// <summary>
+	/// appends audio that is already 16 bit (interleaved if more then 1 channel)
+	/// </summary>
+	/// <param name="data">- audio</param>
+	/// <param name="count">- amount of samples</param>
+	void Write(const int16_t* data, const size_t& count)
+	{
+		if (!IsOpen())
+		{
+			return;
+		}
+
+		if constexpr (std::endian::native == std::endian::little)
+		{
+			WavStream.write(reinterpret_cast<const char*>(data), count * sizeof(int16_t));
+		}
+		else
+		{
+			Buffer.resize(std::min(count, WavWriteBlockSize));
+
+			for (size_t offset = 0; offset < count; offset += WavWriteBlockSize)
+			{
+				size_t blockCount = std::min(WavWriteBlockSize, count - offset);
+
+				for (size_t i = 0; i < blockCount; i++)
+				{
+					uint16_t value = uint16_t(data[offset + i]);
+					Buffer[i] = int16_t((value >> 8) | (value << 8));
+				}
+				WavStream.write(reinterpret_cast<char*>(Buffer.data()), blockCount * sizeof(int16_t));
+			}
+		}
+
+		AddWritten(count);
+	}
+
+	/// <summary>
+	/// patches the sizes into the header and closes the file
+	/// </summary>
+	void Close()
+	{
+		if (!IsOpen())
+		{
+			return;
+		}
+
+		if ((DataBytes / sizeof(int16_t)) % Channels != 0)
+		{
+			fprintf(stderr, "channels don't fit into data size (maybe the wrong channel count was picked)\n");
+		}
+
+		PatchHeader();
+		WavStream.close();
+	}
+
+	uint64_t GetSamplesWritten()
+	{
+		return DataBytes / sizeof(int16_t);
+	}
+
+private:
+	std::fstream WavStream;
+	uint16_t Channels;
+	uint32_t SampleRate;
+
+	uint64_t DataBytes = 0;		/* bytes of audio written */
+	uint64_t PatchedBytes = 0;	/* data size that is in the header at the moment */
+	std::vector<int16_t> Buffer;
+
+	/* counts written samples, and patches the header every HeaderRefreshBytes */
+	void AddWritten(const size_t& count)
+	{
+		DataBytes += count * sizeof(int16_t);
 
-/* float to little endian short array */
-inline void f2les_array(const float* src, uint16_t* dest, int count, int normalize)
+		if (DataBytes - PatchedBytes >= HeaderRefreshBytes)
+		{
+			PatchHeader();
+			WavStream.flush();
+		}
+	}
+
+	void FillHeader(char* header, const uint64_t& dataBytes)
+	{
+		memcpy(header + 8, "WAVE", 4);
+
+		/* JUNK Sub Chunk (room for ds64) */
+		memset(header + Ds64Position, 0, 8 + Ds64Size);
+		PutLittleEndian(header + Ds64Position + 4, Ds64Size, 4);
+
+		/* fmt Sub Chunk */
+		char* fmt = header + FmtPosition;
+		memcpy(fmt + 0, "fmt ", 4); /* yes, the space in that text has to be there */
+		PutLittleEndian(fmt + 4, 16, 4);
+		PutLittleEndian(fmt + 8, 1, 2); /* PCM */
+		PutLittleEndian(fmt + 10, Channels, 2);
+		PutLittleEndian(fmt + 12, SampleRate, 4);
+		PutLittleEndian(fmt + 16, (SampleRate * Channels * BitsPerSample) / 8, 4);
+		PutLittleEndian(fmt + 20, (Channels * BitsPerSample) / 8, 2);
+		PutLittleEndian(fmt + 22, BitsPerSample, 2);
+
+		/* data Sub Chunk */
+		memcpy(header + DataPosition, "data", 4);
+
+		/* sizes (and RIFF or RF64) */
+		FillRiffSizes(header, Ds64Position, header + DataPosition + 4, DataPosition + 4, dataBytes, (Channels * BitsPerSample) / 8);
+	}
+
+	void PatchHeader()
+	{
+		char header[HeaderSize];
+		FillHeader(header, DataBytes);
+
+		WavStream.seekp(0, std::ios::beg);
+		WavStream.write(header, HeaderSize);
+		WavStream.seekp(0, std::ios::end);
+
+		PatchedBytes = DataBytes;
+	}
+};
+
+/// <summary>
+/// Fixes the sizes of a WAV file that didn't get closed (program got killed while writing), using the actual file size.
+/// if the audio is over 4GB and the file has a JUNK (or ds64) chunk to use, it gets turned into RF64
+/// </summary>
+/// <param name="filePath">- path to the WAV file</param>
+/// <returns>true if the file was fixed (or didn't need fixing)</returns>
+bool RecoverWav(const std::filesystem::path& filePath)
 {
-	unsigned char* ucptr;
-	float			normfact;
-	int				value;
+	if (!std::filesystem::exists(filePath))
+	{
+		printf("not file found at: %s\n", filePath.string().c_str());
+		return false;
+	}
+
+	uint64_t fileSize = std::filesystem::file_size(filePath);
+	std::fstream wavStream(filePath, std::ios::binary | std::ios::in | std::ios::out);
+
+	/* a copy of the start of the file, sizes get filled into this and written back */
+	std::vector<char> header(std::min<uint64_t>(fileSize, 4096));
+	wavStream.read(header.data(), header.size());
+
+	if (header.size() < 12 || (memcmp(header.data(), "RIFF", 4) != 0 && memcmp(header.data(), "RF64", 4) != 0) || memcmp(header.data() + 8, "WAVE", 4) != 0)
+	{
+		printf("%s isn't a WAV file\n", filePath.string().c_str());
+		return false;
+	}
 
-	normfact = normalize ? (1.0 * 0x7FFF) : 1.0;
+	/* walk chunks until the data chunk */
+	uint64_t position = 12;
+	uint64_t ds64Position = 0;
+	uint16_t blockAlign = 1;
 
-	for (int i = 0; i < count; i++)
+	while (position + 8 <= header.size())
 	{
-		ucptr = (unsigned char*)&dest[i];
-		value = lrintf(src[i] * normfact);
-		ucptr[0] = value;
-		ucptr[1] = value >> 8;
-	};
+		char* chunk = header.data() + position;
+		uint32_t chunkSize = NosLib::Byte::ByteToArithematic<uint32_t>(chunk + 4);
+
+		if ((memcmp(chunk, "JUNK", 4) == 0 || memcmp(chunk, "ds64", 4) == 0) && chunkSize >= Ds64Size && position + 8 + Ds64Size <= header.size())
+		{
+			ds64Position = position;
+		}
+		else if (memcmp(chunk, "fmt ", 4) == 0 && position + 8 + 16 <= header.size())
+		{
+			blockAlign = std::max<uint16_t>(NosLib::Byte::ByteToArithematic<uint16_t>(chunk + 20), 1);
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			/* everything after the data chunk header is audio, cut to whole sample frames */
+			uint64_t dataBytes = fileSize - (position + 8);
+			if (ds64Position == 0)
+			{
+				dataBytes = std::min<uint64_t>(dataBytes, 0xFFFFFFFF - (position + 8));
+			}
+			dataBytes -= dataBytes % blockAlign;
+
+			FillRiffSizes(header.data(), ds64Position, chunk + 4, position + 4, dataBytes, blockAlign);
+
+			wavStream.seekp(0, std::ios::beg);
+			wavStream.write(header.data(), position + 8);
+
+			printf("Recovered %s (%llu bytes of audio)\n", filePath.string().c_str(), (unsigned long long)dataBytes);
+			return true;
+		}
+
+		position += 8 + uint64_t(chunkSize) + (chunkSize & 1); /* chunks are padded to even sizes */
+	}
+
+	printf("%s doesn't have a data chunk\n", filePath.string().c_str());
+	return false;
 }
 
 /* will write data to Wav file */
 
 void WriteData(const std::filesystem::path& filePath, float* data, const size_t& dataSize, const uint8_t& channels, const uint32_t& sampleRate)
 {
-	const uint8_t bitsPerSample = 16;
-
 	if (dataSize % channels != 0)
 	{
 		throw std::invalid_argument("channels don't fit into data size (maybe the wrong channel count was picked)");
 		return;
 	}
 
-	std::ofstream wavWriteStream(filePath, std::ios::binary | std::ios::trunc);
+	WavWriter writer(filePath, channels, sampleRate);
+	writer.Write(data, dataSize);
+	writer.Close();
+}
 
-	/* create nullptr char arrays (char is 1 byte, so you can use it as bytes) */
-	char* fileSize = nullptr;
-	char* fmtSubChunkSize = nullptr;
-	char* typeFormat = nullptr;
-	char* channelCount = nullptr;
-	char* sampleRateB = nullptr;
-	char* byteRate = nullptr;
-	char* blockAlign = nullptr;
-	char* bitsPerSampleB = nullptr;
-	char* dataSubChunkSize = nullptr;
+/* will write 16 bit data to Wav file */
 
-	/* convert all data into binary in the format that WAV needs */
-	NosLib::Byte::ArithematicToByte<uint32_t>(4+(8+16)+(8+ dataSize * 2), &fileSize);
-	NosLib::Byte::ArithematicToByte<uint32_t>(16, &fmtSubChunkSize);
-	NosLib::Byte::ArithematicToByte<uint8_t>(1, &typeFormat);
-	NosLib::Byte::ArithematicToByte<uint8_t>(channels, &channelCount);
-	NosLib::Byte::ArithematicToByte<uint32_t>(sampleRate, &sampleRateB);
-	NosLib::Byte::ArithematicToByte<uint32_t>((sampleRate*channels*bitsPerSample)/8, &byteRate);
-	NosLib::Byte::ArithematicToByte<uint8_t>((channels*bitsPerSample)/8, &blockAlign);
-	NosLib::Byte::ArithematicToByte<uint8_t>(bitsPerSample, &bitsPerSampleB);
-	NosLib::Byte::ArithematicToByte<uint32_t>(dataSize*2, &dataSubChunkSize);
+void WriteData(const std::filesystem::path& filePath, const int16_t* data, const size_t& dataSize, const uint8_t& channels, const uint32_t& sampleRate)
+{
+	if (dataSize % channels != 0)
+	{
+		throw std::invalid_argument("channels don't fit into data size (maybe the wrong channel count was picked)");
+	}
 
-	/* start writing all the header data into file */
+	WavWriter writer(filePath, channels, sampleRate);
+	writer.Write(data, dataSize);
+	writer.Close();
+}
 
-	wavWriteStream.write("RIFF", 4);
-	wavWriteStream.write(fileSize, 4);
-	wavWriteStream.write("WAVE", 4);
+/// <summary>
+/// reads a little endian number out of a byte array
+/// </summary>
+/// <param name="src">- bytes</param>
+/// <param name="byteCount">- how many bytes the number takes up</param>
+/// <returns>number</returns>
+inline uint64_t GetLittleEndian(const uint8_t* src, const size_t& byteCount)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < byteCount; i++)
+	{
+		value |= uint64_t(src[i]) << (i * 8);
+	}
+	return value;
+}
 
-	/* fmt Sub Chunk */
-	wavWriteStream.write("fmt ", 4); /* yes, the space in that text has to be there */
-	wavWriteStream.write(fmtSubChunkSize, 4);
-	wavWriteStream.write(typeFormat, 2);
-	wavWriteStream.write(channelCount, 2);
-	wavWriteStream.write(sampleRateB, 4);
-	wavWriteStream.write(byteRate, 4);
-	wavWriteStream.write(blockAlign, 2);
-	wavWriteStream.write(bitsPerSampleB, 2);
+/* sample formats (wFormatTag) */
+const uint16_t WavFormatPCM = 1;
+const uint16_t WavFormatFloat = 3;
+const uint16_t WavFormatExtensible = 0xFFFE;
 
-	/* data Sub Chunk */
-	wavWriteStream.write("data", 4);
-	wavWriteStream.write(dataSubChunkSize, 4);
+/// <summary>
+/// format of a WAV file, from its fmt chunk
+/// </summary>
+struct WavFormat
+{
+	uint16_t Format = 0;		/* WavFormatPCM or WavFormatFloat (extensible gets resolved to its sub format) */
+	uint16_t Channels = 0;
+	uint32_t SampleRate = 0;
+	uint16_t BlockAlign = 0;
+	uint16_t BitsPerSample = 0;
+};
 
-	uint16_t* out = new uint16_t[dataSize];
+/* The converters below are all simple loops with no dependencies between samples, so the compiler vectorises them.
+   memcpy is used for the loads, as samples in a mapped file don't have to be aligned */
 
-	f2les_array(data,out, dataSize, 1);
-	for (int i = 0; i < dataSize; i++)
+/* little endian short to float array */
+inline void les2f_array(const uint8_t* src, float* dest, size_t count, float normfact)
+{
+	for (size_t i = 0; i < count; i++)
 	{
-		wavWriteStream.write(reinterpret_cast<char*>(out+i), 2);
+		int16_t value;
+		memcpy(&value, src + i * 2, 2);
+		dest[i] = float(value) * normfact;
 	}
-
-	wavWriteStream.close();
 }
 
-/* little endian short to float array */
-inline void les2f_array(const uint16_t* src, float* dest, int count, float normfact)
+/* unsigned 8 bit to float array */
+inline void u8tof_array(const uint8_t* src, float* dest, size_t count)
 {
-	short	value;
-
-	for (int i = 0; i < count; i++)
+	for (size_t i = 0; i < count; i++)
 	{
-		value = src[i];
-		dest[i] = ((float)value) * normfact;
-	};
+		dest[i] = (float(src[i]) - 128.0f) * (1.0f / 128.0f);
+	}
 }
 
-ArrayWrapper<float> ReadFile(const std::filesystem::path& filePath)
+/* little endian 24 bit to float array */
+inline void le24tof_array(const uint8_t* src, float* dest, size_t count)
 {
-	std::ifstream wavReadStream(filePath, std::ios::binary);
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint8_t* sample = src + i * 3;
+		int32_t value = int32_t(uint32_t(sample[0]) << 8 | uint32_t(sample[1]) << 16 | uint32_t(sample[2]) << 24) >> 8;
+		dest[i] = float(value) * (1.0f / 8388608.0f);
+	}
+}
 
-	/* create char arrays (char is 1 byte, and so can be used as a byte array) */
+/* little endian 32 bit to float array */
+inline void le32tof_array(const uint8_t* src, float* dest, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		int32_t value;
+		memcpy(&value, src + i * 4, 4);
+		dest[i] = float(value) * (1.0f / 2147483648.0f);
+	}
+}
 
-	char fileSize[4];
-	char fmtSubChunkSize[4];
-	char typeFormat[2];
-	char channelCount[2];
-	char sampleRateB[4];
-	char byteRate[4];
-	char blockAlign[2];
-	char bitsPerSampleB[2];
-	char dataSubChunkSize[4];
+/* little endian 64 bit float to float array */
+inline void lef64tof_array(const uint8_t* src, float* dest, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		double value;
+		memcpy(&value, src + i * 8, 8);
+		dest[i] = float(value);
+	}
+}
 
-	/* used for all text fields, I don't care about their data but you have to put is some where */
-	char textValidation[4];
+/// <summary>
+/// converts raw WAV samples into floats (-1 to 1)
+/// </summary>
+/// <param name="src">- raw samples</param>
+/// <param name="dest">- floats out</param>
+/// <param name="count">- amount of samples</param>
+/// <param name="format">- sample format</param>
+/// <returns>false if the format isn't supported</returns>
+inline bool SamplesToFloat(const uint8_t* src, float* dest, const size_t& count, const WavFormat& format)
+{
+	if (format.Format == WavFormatPCM)
+	{
+		switch (format.BitsPerSample)
+		{
+		case 8:
+			u8tof_array(src, dest, count);
+			return true;
+		case 16:
+			les2f_array(src, dest, count, 1.0f / 32768.0f);
+			return true;
+		case 24:
+			le24tof_array(src, dest, count);
+			return true;
+		case 32:
+			le32tof_array(src, dest, count);
+			return true;
+		}
+	}
+	else if (format.Format == WavFormatFloat)
+	{
+		switch (format.BitsPerSample)
+		{
+		case 32:
+			memcpy(dest, src, count * sizeof(float));
+			return true;
+		case 64:
+			lef64tof_array(src, dest, count);
+			return true;
+		}
+	}
 
-	/* read all the data from file */
+	return false;
+}
 
-	wavReadStream.read(textValidation, 4);
-	//if (!NosLib::Byte::ByteCompare(textValidation, "RIFF", 4))
-	//{
-	//	printf("RIFF section doesn't line up\n");
-	//	return 0;
-	//}
+/// <summary>
+/// checks if a file is a WAV (or RF64) file, by its header
+/// </summary>
+/// <param name="filePath">- path to the file</param>
+/// <returns>true if it is a WAV file</returns>
+inline bool IsWavFile(const std::filesystem::path& filePath)
+{
+	std::ifstream file(filePath, std::ios::binary);
+	char header[12];
 
-	wavReadStream.read(fileSize, 4);
-	wavReadStream.read(textValidation, 4);
-	//if (!NosLib::Byte::ByteCompare(textValidation, "WAVE", 4))
-	//{
-	//	printf("format doesn't match, should be WAVE, instead got %s\n", textValidation);
-	//	return 0;
-	//}
+	if (!file.read(header, sizeof(header)))
+	{
+		return false;
+	}
 
-	/* fmt Sub Chunk */
-	wavReadStream.read(textValidation, 4);
-	//if (!NosLib::Byte::ByteCompare(textValidation, "fmt ", 4) )
-	//{
-	//	printf("fmt section doesn't line up\n");
-	//	return 0;
-	//}
+	return (memcmp(header, "RIFF", 4) == 0 || memcmp(header, "RF64", 4) == 0) && memcmp(header + 8, "WAVE", 4) == 0;
+}
 
-	wavReadStream.read(fmtSubChunkSize, 4);
-	wavReadStream.read(typeFormat, 2);
-	wavReadStream.read(channelCount, 2);
-	wavReadStream.read(sampleRateB, 4);
-	wavReadStream.read(byteRate, 4);
-	wavReadStream.read(blockAlign, 2);
-	wavReadStream.read(bitsPerSampleB, 2);
+/// <summary>
+/// Reads a WAV (or RF64) file into floats (-1 to 1), interleaved if more then 1 channel.
+/// the file gets memory mapped and its chunks walked, anything that isn't fmt, ds64 or data (LIST, fact, bext, JUNK...) gets skipped,
+/// and the samples get converted straight out of the mapping
+/// </summary>
+/// <param name="filePath">- path to the WAV file</param>
+/// <param name="formatOut">- format of the file (optional)</param>
+/// <returns>samples (empty if the file couldn't be read)</returns>
+ArrayWrapper<float> ReadFile(const std::filesystem::path& filePath, WavFormat* formatOut = nullptr)
+{
+	MappedFile wavFile(filePath);
 
-	/* data Sub Chunk */
-	wavReadStream.read(textValidation, 4);
-	//if (!NosLib::Byte::ByteCompare(textValidation, "data", 4))
-	//{
-	//	printf("Data section doesn't line up, instead got %s\n", textValidation);
-	//	return 0;
-	//}
-	wavReadStream.read(dataSubChunkSize, 4);
+	if (!wavFile.IsOpen())
+	{
+		printf("not file found at: %s\n", filePath.string().c_str());
+		return ArrayWrapper<float>();
+	}
 
-	/* convert all the data we care about from byte to int */
+	const uint8_t* data = wavFile.Data();
+	const uint64_t fileSize = wavFile.Size();
 
-	uint8_t channels = NosLib::Byte::ByteToArithematic<uint8_t>(channelCount);
-	uint32_t sampleRate=  NosLib::Byte::ByteToArithematic<uint32_t>(sampleRateB);
-	uint32_t dataSize = NosLib::Byte::ByteToArithematic<uint32_t>(dataSubChunkSize)/2;
+	/* RIFF (or RF64 if the file is over 4GB) */
+	if (fileSize < 12 || (memcmp(data, "RIFF", 4) != 0 && memcmp(data, "RF64", 4) != 0) || memcmp(data + 8, "WAVE", 4) != 0)
+	{
+		printf("%s isn't a WAV file\n", filePath.string().c_str());
+		return ArrayWrapper<float>();
+	}
 
-	/* read the rest of the data into uint16_t (same size as float16) */
+	/* walk sub chunks until the data chunk */
+	WavFormat format;
+	uint64_t ds64DataSize = 0;
 
-	uint16_t* in = new uint16_t[dataSize];
-	for (int i = 0; i < dataSize; i++)
+	for (uint64_t position = 12; position + 8 <= fileSize;)
 	{
-		wavReadStream.read(reinterpret_cast<char*>(in + i), 2);
+		const uint8_t* chunk = data + position;
+		uint64_t chunkSize = GetLittleEndian(chunk + 4, 4);
+		uint64_t available = fileSize - (position + 8);
+
+		if (memcmp(chunk, "ds64", 4) == 0 && available >= 16)
+		{
+			ds64DataSize = GetLittleEndian(chunk + 16, 8);
+		}
+		else if (memcmp(chunk, "fmt ", 4) == 0 && available >= 16)
+		{
+			format.Format = uint16_t(GetLittleEndian(chunk + 8, 2));
+			format.Channels = uint16_t(GetLittleEndian(chunk + 10, 2));
+			format.SampleRate = uint32_t(GetLittleEndian(chunk + 12, 4));
+			format.BlockAlign = uint16_t(GetLittleEndian(chunk + 20, 2));
+			format.BitsPerSample = uint16_t(GetLittleEndian(chunk + 22, 2));
+
+			/* extensible: the real format is the first 2 bytes of the sub format GUID */
+			if (format.Format == WavFormatExtensible && chunkSize >= 40 && available >= 40)
+			{
+				format.Format = uint16_t(GetLittleEndian(chunk + 32, 2));
+			}
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			if (format.Channels == 0 || format.BlockAlign == 0)
+			{
+				printf("%s has no fmt section before its data\n", filePath.string().c_str());
+				return ArrayWrapper<float>();
+			}
+
+			uint64_t dataBytes = (chunkSize == 0xFFFFFFFF && ds64DataSize != 0) ? ds64DataSize : chunkSize;
+			dataBytes = std::min(dataBytes, available); /* file might have been cut off */
+
+			size_t sampleCount = size_t(dataBytes / format.BlockAlign) * format.Channels;
+			uint16_t bytesPerSample = format.BlockAlign / format.Channels;
+
+			if (bytesPerSample * 8 != format.BitsPerSample)
+			{
+				/* samples padded to whole bytes (20 bit in 24 and such), treat it as the container size */
+				format.BitsPerSample = bytesPerSample * 8;
+			}
+
+			wavFile.AdviseSequential();
+
+			ArrayWrapper<float> outArray(sampleCount);
+			if (!SamplesToFloat(chunk + 8, outArray.data, sampleCount, format))
+			{
+				printf("unsupported sample format (format %u, %u bits)\n", format.Format, format.BitsPerSample);
+				outArray.Delete();
+				return ArrayWrapper<float>();
+			}
+
+			if (formatOut != nullptr)
+			{
+				*formatOut = format;
+			}
+
+			return outArray;
+		}
+
+		position += 8 + chunkSize + (chunkSize & 1); /* chunks are padded to even sizes */
 	}
-	ArrayWrapper<float> outArray(dataSize);
-	/* convert from uint16_t (float16) to float (float32) */
-	les2f_array(in, outArray.data, dataSize, 1);
 
-	return outArray;
-}
\ No newline at end of file
+	printf("Data section not found\n");
+	return ArrayWrapper<float>();
+}
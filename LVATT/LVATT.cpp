@@ -1,6 +1,14 @@
 ﻿#include "Headers/AudioTranscribing.hpp"
 #include "Headers/WAV.hpp"
+#include "Headers/FLAC.hpp"
 #include "Headers/SignalProcessing.hpp"
+#include "Headers/AudioProcessing.hpp"
+#include "Headers/ClipExport.hpp"
+#include "Headers/SampleStorage.hpp"
+#include "Headers/OutputService.hpp"
+#include "Headers/StreamingTranscriber.hpp"
+#include "Headers/ModelBenchmark.hpp"
+#include "Headers/TranscriptFiles.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -8,24 +16,459 @@
 #include <complex>
 #include <format>
 #include <chrono>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <sstream>
 
 /* Output */
 //const int OutSampleRate = 48000; /* 48KHz */
 const int OutSampleRate = 16000; /* 16KHz */ /* Whisper requires the audio to be of sample rate 16KHz */
 const int OutChannels = 1;
 
-int main()
+/* Pipeline */
+const size_t DspWorkerCount = 2; /* files demodulated at the same time, the front end is one serial filter chain per file */
+
+/* Live */
+const double DefaultLiveBandwidth = 12500.0; /* NFM channel */
+
+/* Scan */
+const double TransmissionPadding = 0.25; /* seconds kept before and after a detected transmission */
+
+/// <summary>
+/// asks which format the demodulated audio gets kept in
+/// </summary>
+/// <returns>true for FLAC, false for WAV</returns>
+bool GetArchiveFormat()
+{
+	while (true)
+	{
+		std::string input;
+		printf("\nPlease choose the format to keep the audio in\nwav\nflac (lossless, about half the size)\n[Default = wav]: ");
+		std::getline(std::cin, input);
+
+		if (input.empty() || input == "wav")
+		{
+			return false;
+		}
+
+		if (input == "flac")
+		{
+			return true;
+		}
+
+		printf("Input was invalid, try again\n");
+	}
+}
+
+/// <summary>
+/// asks if the transcripts get translated into english or stay in the spoken language
+/// </summary>
+/// <returns>true if they get translated</returns>
+bool GetTranslate()
+{
+	std::string input;
+	printf("\nTranslate the transcripts into english? [Y/n]: ");
+	std::getline(std::cin, input);
+
+	return !(input == "n" || input == "N");
+}
+
+/// <summary>
+/// asks how whisper should decode, and if it translates
+/// </summary>
+/// <returns>decoding profile</returns>
+DecodingProfile GetDecodingProfile()
+{
+	DecodingProfile decodingProfile;
+
+	while (true)
+	{
+		std::string input;
+		printf("\nPlease choose the decoding profile\nfast (greedy, no fallback, shorter encoder window for short transmissions)\nbalanced\naccurate (beam search)\n[Default = balanced]: ");
+		std::getline(std::cin, input);
+
+		const DecodingProfile* profile = input.empty() ? &DecodingProfiles[DefaultDecodingProfile] : FindDecodingProfile(input);
+		if (profile != nullptr)
+		{
+			decodingProfile = *profile;
+			break;
+		}
+
+		printf("Input was invalid, try again\n");
+	}
+
+	decodingProfile.Translate = GetTranslate();
+	return decodingProfile;
+}
+
+/// <summary>
+/// asks which transcript files get written next to the audio
+/// </summary>
+/// <returns>formats to write</returns>
+TranscriptFormats GetTranscriptFormats()
+{
+	while (true)
+	{
+		std::string input;
+		printf("\nPlease input the transcript files to write next to the audio [Separate each with ,]\nsrt\nvtt\njson (segments, token timing and probabilities, language)\n[Default = none]: ");
+		std::getline(std::cin, input);
+
+		TranscriptFormats formats;
+		bool valid = true;
+
+		NosLib::DynamicArray<std::string> splitOut;
+		NosLib::String::Split<char>(&splitOut, input, ',');
+
+		for (int i = 0; i <= splitOut.GetLastArrayIndex(); i++)
+		{
+			std::string format = NosLib::String::Trim(splitOut[i]);
+
+			if (format == "srt")
+			{
+				formats.Srt = true;
+			}
+			else if (format == "vtt")
+			{
+				formats.Vtt = true;
+			}
+			else if (format == "json")
+			{
+				formats.Json = true;
+			}
+			else if (!format.empty())
+			{
+				valid = false;
+			}
+		}
+
+		if (valid)
+		{
+			return formats;
+		}
+
+		printf("Input was invalid, try again\n");
+	}
+}
+
+/// <summary>
+/// callback for a transcription job that queues its transcript files, once the segments are in
+/// </summary>
+/// <param name="output">- output service the files get written with</param>
+/// <param name="inputPath">- file being transcribed, the transcripts go next to it</param>
+/// <param name="formats">- files to write</param>
+/// <returns>callback, empty if no files get written</returns>
+std::function<void(std::vector<TranscriptSegment>&)> TranscriptWriter(OutputService& output, const std::string& inputPath, const TranscriptFormats& formats)
+{
+	if (!formats.Any())
+	{
+		return nullptr;
+	}
+
+	std::string basePath = inputPath.substr(0, inputPath.find_last_of('.'));
+	return [&output, basePath, inputPath, formats](std::vector<TranscriptSegment>& segments)
+		{
+			SubmitTranscriptWrite(output, basePath, inputPath, std::move(segments), formats);
+		};
+}
+
+/// <summary>
+/// cleans up demodulated audio, before it gets written to file or transcribed
+/// </summary>
+/// <param name="demodulated">- audio straight from the demodulator (compact), freed once the noise reducer is done with it</param>
+/// <param name="transmissionsOut">- if set, parts of the audio where the squelch was open</param>
+/// <param name="blockOut">- if set, gets the finished audio block by block as the AGC gives it out (see ApplyAutomaticGainControl)</param>
+/// <returns>cleaned up audio</returns>
+ArrayWrapper<float> PrepareAudio(CompactBuffer& demodulated, std::vector<AudioSpan>* transmissionsOut = nullptr, const std::function<void(const float*, const size_t&)>& blockOut = nullptr)
+{
+	/* take out the FM noise (and mute the squelch closed parts), so whisper doesn't waste time on it */
+	printf("Reducing noise\n");
+	SpectralNoiseReducer noiseReducer(OutSampleRate);
+	ArrayWrapper<float> audio = noiseReducer.Process(demodulated);
+	demodulated.Delete();
+
+	/* normalise the discriminator output (radians) so it uses the 16 bit range without clipping, before both the wav file and whisper */
+	AutomaticGainControl agc(OutSampleRate);
+	ApplyAutomaticGainControl(audio, agc, blockOut);
+
+	if (transmissionsOut != nullptr)
+	{
+		*transmissionsOut = noiseReducer.GetTransmissions();
+	}
+
+	return audio;
+}
+
+/// <summary>
+/// queues audio to be written on the output thread, as 16 bit samples (what both file formats hold), so the queued copy takes half the memory
+/// </summary>
+/// <param name="output">- output service</param>
+/// <param name="filePath">- path to the file, without the extension (gets appended, as the name itself can have dots in it)</param>
+/// <param name="audio">- audio to write, moved into the task</param>
+/// <param name="archiveFlac">- true for FLAC, false for WAV</param>
+void SubmitAudioWrite(OutputService& output, const std::filesystem::path& filePath, CompactBuffer&& audio, const bool& archiveFlac)
+{
+	output.Submit([filePath, audio = std::move(audio), archiveFlac]()
+		{
+			if (archiveFlac)
+			{
+				WriteFlac(std::filesystem::path(filePath.string() + ".flac"), audio.GetInt16Data(), audio.size(), OutChannels, OutSampleRate);
+			}
+			else
+			{
+				WriteData(std::filesystem::path(filePath.string() + ".wav"), audio.GetInt16Data(), audio.size(), OutChannels, OutSampleRate);
+			}
+		});
+}
+
+/// <summary>
+/// demodulates and cleans up a file, queues it to be written and hands it to the scheduler
+/// </summary>
+/// <param name="inputFile">- file to process</param>
+/// <param name="output">- output service the audio file gets written with</param>
+/// <param name="scheduler">- scheduler the audio gets transcribed on</param>
+/// <param name="archiveFlac">- true for FLAC, false for WAV</param>
+/// <param name="transcriptFormats">- transcript files written once it has been transcribed</param>
+void PrepareFile(const InputFile& inputFile, OutputService& output, TranscriptionScheduler& scheduler, const bool& archiveFlac, const TranscriptFormats& transcriptFormats)
 {
 	auto start = std::chrono::high_resolution_clock::now();
 
+	if (inputFile.IsAudio)
+	{
+		/* already demodulated, just needs to be at whisper's sample rate. no DSP and no WAV written back out */
+		ArrayWrapper<float> audio = WavToAudio(inputFile.FilePath, OutSampleRate);
+
+		if (audio.data == nullptr)
+		{
+			printf("No audio read\nskipping...\n");
+			return;
+		}
+
+		auto stop = std::chrono::high_resolution_clock::now();
+
+		printf("Reading audio took: %lld milliseconds\n", std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+
+		TranscriptionJob job;
+		job.Name = inputFile.FilePath;
+		job.Audio = audio;
+		job.Done = TranscriptWriter(output, inputFile.FilePath, transcriptFormats);
+		scheduler.Submit(std::move(job));
+		return;
+	}
+
+	/* input and demodulate IQ file */
+	CompactBuffer demodulated = IQtoAudio(inputFile, OutSampleRate);
+
+	if (demodulated.size() == 0)
+	{
+		printf("No audio signal generated (most likely file doesn't exist)\nskipping...\n");
+		return;
+	}
+
+	std::string basePath = inputFile.FilePath.substr(0, inputFile.FilePath.find_last_of('.'));
+	ArrayWrapper<float> audio;
+	std::vector<AudioSpan> transmissions;
+
+	printf("Writing audio signal to file\n");
+	if (archiveFlac)
+	{
+		/* FLAC frames get encoded in parallel over the whole file, so it gets written once the audio is done (in the background while whisper runs) */
+		audio = PrepareAudio(demodulated, &transmissions);
+		SubmitAudioWrite(output, basePath, CompactBuffer(audio, SampleStorage::Int16), archiveFlac);
+	}
+	else
+	{
+		/* the wav file gets written on the output thread as the AGC gives out each block, instead of a 16 bit copy of the whole file afterwards */
+		WavOutputStream wavStream(output, basePath + ".wav", OutChannels, OutSampleRate);
+		audio = PrepareAudio(demodulated, &transmissions, [&wavStream](const float* data, const size_t& count) { wavStream.Write(data, count); });
+		wavStream.Close();
+	}
+
+	auto stop = std::chrono::high_resolution_clock::now();
+
+	printf("Signal processing took: %lld milliseconds\n", std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+
+	/* take in the data and pass it to whisper for transcribing, only the parts where the squelch was open.
+	   blocks if transcription is too far behind (memory budget), which holds this DSP worker back */
+	TranscriptionJob job;
+	job.Name = inputFile.FilePath;
+	job.Audio = audio;
+	job.Spans = transmissions;
+	job.Done = TranscriptWriter(output, inputFile.FilePath, transcriptFormats);
+	scheduler.Submit(std::move(job));
+}
+
+/// <summary>
+/// demodulates, writes and transcribes each file. works as a pipeline: DSP workers prepare the next files while whisper
+/// transcribes the earlier ones (on the scheduler's threads) and files get written on the output thread
+/// </summary>
+void TranscribeFiles()
+{
+	ArrayWrapper<InputFile> files = GatherUserInput();
+
+	std::string modelPath = GetModel();
+	PreloadWhisperContext(modelPath); /* loads alongside the DSP of the first file, instead of after it */
+
+	bool archiveFlac = GetArchiveFormat();
+	TranscriptFormats transcriptFormats = GetTranscriptFormats();
+	DecodingProfile decodingProfile = GetDecodingProfile();
+
+	OutputService output;
+	TranscriptionScheduler scheduler(modelPath, decodingProfile);
+
+	std::atomic<size_t> nextFile = 0;
+	std::vector<std::thread> dspWorkers;
+	for (size_t worker = 0; worker < std::min<size_t>(DspWorkerCount, files.size); worker++)
+	{
+		dspWorkers.emplace_back([&]()
+			{
+				for (size_t i = nextFile++; i < files.size; i = nextFile++)
+				{
+					PrepareFile(files[int(i)], output, scheduler, archiveFlac, transcriptFormats);
+				}
+			});
+	}
+
+	for (std::thread& worker : dspWorkers)
+	{
+		worker.join();
+	}
+
+	scheduler.Finish();
+	output.Finish();
+	files.Delete();
+	FreeWhisperContext();
+}
+
+/// <summary>
+/// finds transmissions in wideband captures, writes an activity table for each file, and can transcribe each transmission
+/// </summary>
+void ScanFiles()
+{
+	ArrayWrapper<InputFile> files = GatherUserInput(false); /* every transmission gets its own channel, a fixed cut off would override that */
+
+	std::string input;
+	printf("\nTranscribe detected transmissions? [y/N]: ");
+	std::getline(std::cin, input);
+	bool transcribe = (input == "y" || input == "Y");
+
+	std::string modelPath;
+	if (transcribe)
+	{
+		modelPath = GetModel();
+		PreloadWhisperContext(modelPath);
+	}
+
+	OutputService output;
+
+	/* transmissions are short and many, so several get transcribed at once */
+	std::unique_ptr<TranscriptionScheduler> scheduler;
+	if (transcribe)
+	{
+		scheduler = std::make_unique<TranscriptionScheduler>(modelPath);
+	}
+
+	for (int i = 0; i < files.size; i++)
+	{
+		if (files[i].IsAudio)
+		{
+			printf("%s is audio, nothing to scan\nskipping...\n", files[i].FilePath.c_str());
+			continue;
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		printf("Scanning %s\n", files[i].FilePath.c_str());
+		std::vector<ActivityRecord> records = ScanActivity(files[i].FilePath, files[i].FileSampleRate);
+		output.Submit([tablePath = files[i].FilePath.substr(0, files[i].FilePath.find_last_of('.')) + ".activity.csv", records]()
+			{
+				WriteActivityTable(tablePath, records);
+			});
+
+		auto stop = std::chrono::high_resolution_clock::now();
+
+		printf("Scanning took: %lld milliseconds\n", std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+
+		if (!transcribe)
+		{
+			continue;
+		}
+
+		for (const ActivityRecord& record : records)
+		{
+			/* the transmission's own channel and time span, straight into the demodulator */
+			InputFile transmission = files[i];
+			double startTime = std::max(record.StartTime - TransmissionPadding, 0.0);
+			transmission.StartSample = size_t(startTime * transmission.FileSampleRate);
+			transmission.SampleCount = size_t((record.EndTime + TransmissionPadding - startTime) * transmission.FileSampleRate);
+			transmission.CentreFrequency = record.CentreFrequency;
+			transmission.Bandwidth = record.Bandwidth;
+
+			printf("\nTransmission %.2fs - %.2fs at %.0fHz\n", record.StartTime, record.EndTime, record.CentreFrequency);
+
+			CompactBuffer demodulated = IQtoAudio(transmission, OutSampleRate);
+			if (demodulated.size() == 0)
+			{
+				continue;
+			}
+
+			ArrayWrapper<float> audio = PrepareAudio(demodulated);
+
+			TranscriptionJob job;
+			job.Name = std::format("{} {:.2f}s {:.0f}Hz", files[i].FilePath, record.StartTime, record.CentreFrequency);
+			job.Audio = audio;
+			scheduler->Submit(std::move(job));
+		}
+	}
+
+	if (scheduler)
+	{
+		scheduler->Finish();
+	}
+	output.Finish();
+	files.Delete();
+	FreeWhisperContext();
+}
+
+/// <summary>
+/// writes every transmission as its own clip (into "<file>.clips"), with a JSONL index of where each one came from and what was said.
+/// transmissions come from the squelch, or from whisper's segments if the audio has no squelch information (WAV input or a squelch that never closed)
+/// </summary>
+void ExportFiles()
+{
 	ArrayWrapper<InputFile> files = GatherUserInput();
 
 	std::string modelPath = GetModel();
+	PreloadWhisperContext(modelPath);
+
+	bool archiveFlac = GetArchiveFormat();
+	DecodingProfile decodingProfile = GetDecodingProfile();
+
+	OutputService output;
+	TranscriptionScheduler scheduler(modelPath, decodingProfile);
 
 	for (int i = 0; i < files.size; i++)
 	{
-		/* input and demodulate IQ file */
-		ArrayWrapper<float> audio = IQtoAudio(files[i].FilePath, files[i].FileSampleRate, files[i].CutOffFrequency, OutSampleRate);
+		ArrayWrapper<float> audio;
+		std::vector<AudioSpan> transmissions;
+		double sourceSampleRate;
+
+		if (files[i].IsAudio)
+		{
+			WavFormat format;
+			audio = WavToAudio(files[i].FilePath, OutSampleRate, &format);
+			sourceSampleRate = format.SampleRate;
+		}
+		else
+		{
+			CompactBuffer demodulated = IQtoAudio(files[i], OutSampleRate);
+			sourceSampleRate = double(files[i].FileSampleRate);
+
+			if (demodulated.size() != 0)
+			{
+				audio = PrepareAudio(demodulated, &transmissions);
+			}
+		}
 
 		if (audio.data == nullptr)
 		{
@@ -33,28 +476,450 @@ int main()
 			continue;
 		}
 
-		/* write the data into a wav file */
-		printf("Writing audio signal to file\n");
-		WriteData(files[i].FilePath.substr(0,files[i].FilePath.find_last_of('.')) + ".wav", audio.data, audio.size, OutChannels, OutSampleRate);
+		/* one whisper pass over the audio (batches spread over the scheduler's states), each clip then takes the segments inside it */
+		std::promise<std::vector<TranscriptSegment>> transcribed;
+		std::future<std::vector<TranscriptSegment>> transcribedFuture = transcribed.get_future();
 
-		auto stop = std::chrono::high_resolution_clock::now();
+		TranscriptionJob job;
+		job.Name = files[i].FilePath;
+		job.Audio = audio;
+		job.OwnsAudio = false;
+		if (!transmissions.empty())
+		{
+			job.Spans = transmissions;
+		}
+		job.Done = [&transcribed](std::vector<TranscriptSegment>& segments) { transcribed.set_value(std::move(segments)); };
+		scheduler.Submit(std::move(job));
 
-		printf("Signal processing took: %lld milliseconds\n", std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+		std::vector<TranscriptSegment> segments = transcribedFuture.get();
 
-		start = std::chrono::high_resolution_clock::now();
+		bool fromSquelch = (transmissions.size() > 1 || (transmissions.size() == 1 && transmissions[0].End - transmissions[0].Start < audio.size));
+		if (!fromSquelch)
+		{
+			transmissions.clear();
+			for (const TranscriptSegment& segment : segments)
+			{
+				transmissions.push_back({ size_t(segment.StartTime * OutSampleRate), std::min(size_t(segment.EndTime * OutSampleRate), audio.size) });
+			}
+		}
 
-		/* take in the data and pass it to whisper for transcribing */
-		TranscribeAudio(audio, modelPath);
-		audio.Delete();
+		std::filesystem::path clipDirectory = files[i].FilePath.substr(0, files[i].FilePath.find_last_of('.')) + ".clips";
+		std::filesystem::create_directories(clipDirectory);
+		/* shared with the write tasks, only the output thread appends to it */
+		std::shared_ptr<ClipIndexWriter> index = std::make_shared<ClipIndexWriter>(clipDirectory / "index.jsonl");
+
+		printf("Exporting %zu transmission\\s (from %s) to %s\n", transmissions.size(), fromSquelch ? "squelch" : "whisper segments", clipDirectory.string().c_str());
+
+		for (size_t clip = 0; clip < transmissions.size(); clip++)
+		{
+			/* whisper segments already sit tight around the speech, squelch ones get some padding so the first and last words aren't clipped */
+			size_t padding = fromSquelch ? size_t(TransmissionPadding * OutSampleRate) : 0;
+			size_t start = transmissions[clip].Start > padding ? transmissions[clip].Start - padding : 0;
+			size_t end = std::min(transmissions[clip].End + padding, audio.size);
+
+			if (end <= start)
+			{
+				continue;
+			}
+
+			ClipRecord record;
+			record.Clip = std::format("clip_{:05}.{}", clip, archiveFlac ? "flac" : "wav");
+			record.Source = files[i].FilePath;
+			record.StartTime = double(files[i].StartSample) / sourceSampleRate + double(start) / OutSampleRate;
+			record.EndTime = double(files[i].StartSample) / sourceSampleRate + double(end) / OutSampleRate;
+			record.SourceOffset = files[i].StartSample + uint64_t(double(start) * sourceSampleRate / OutSampleRate);
+			record.SourceCount = uint64_t(double(end - start) * sourceSampleRate / OutSampleRate);
+			record.Transcript = CollectTranscript(segments, double(start) / OutSampleRate, double(end) / OutSampleRate);
+
+			CompactBuffer clipAudio(end - start, SampleStorage::Int16);
+			clipAudio.Store(audio.data + start, end - start, 0);
+			SubmitAudioWrite(output, clipDirectory / std::format("clip_{:05}", clip), std::move(clipAudio), archiveFlac);
 
-		stop = std::chrono::high_resolution_clock::now();
+			/* after the clip, so the index never points at a clip that isn't written yet */
+			output.Submit([index, record = std::move(record)]()
+				{
+					index->Append(record);
+				});
+		}
 
-		printf("Audio Transcribing took: %lld milliseconds\n", std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count());
+		audio.Delete();
 	}
 
+	scheduler.Finish();
+	output.Finish();
 	files.Delete();
 	FreeWhisperContext();
+}
+
+/// <summary>
+/// transcribes IQ as it comes in (from a named pipe or a file that an SDR writes into), for live monitoring.
+/// the front end runs block by block like for files, the audio goes to the streaming transcriber
+/// </summary>
+void LiveTranscribe()
+{
+	std::string sourcePath;
+	printf("Input path to the live IQ source (named pipe or file being written to): ");
+	std::getline(std::cin, sourcePath);
+	sourcePath = NosLib::String::Trim(sourcePath);
+
+	InputFile source;
+	source.FilePath = sourcePath;
+
+	while (true)
+	{
+		std::string input;
+		printf("\nPlease input the sample rate [Default:%zuHz]: ", DefaultInSampleRate);
+		std::getline(std::cin, input);
+
+		if (input.empty())
+		{
+			source.FileSampleRate = DefaultInSampleRate;
+			break;
+		}
+
+		if (1 == sscanf(input.c_str(), "%zu", &source.FileSampleRate))
+		{
+			break;
+		}
+
+		printf("Input was invalid, try again\n");
+	}
+
+	/* a live stream can't be measured up front, so the channel is taken as centred and the bandwidth asked for */
+	while (true)
+	{
+		std::string input;
+		printf("\nPlease input the channel bandwidth [Default:%.0fHz]: ", DefaultLiveBandwidth);
+		std::getline(std::cin, input);
+
+		if (input.empty())
+		{
+			source.Bandwidth = DefaultLiveBandwidth;
+			break;
+		}
+
+		if (1 == sscanf(input.c_str(), "%lf", &source.Bandwidth) && source.Bandwidth > 0.0)
+		{
+			break;
+		}
+
+		printf("Input was invalid, try again\n");
+	}
+
+	double latencyTarget = DefaultStreamLatencyTarget;
+	while (true)
+	{
+		std::string input;
+		printf("\nPlease input the latency target in seconds [Default:%.1f]: ", DefaultStreamLatencyTarget);
+		std::getline(std::cin, input);
+
+		if (input.empty() || (1 == sscanf(input.c_str(), "%lf", &latencyTarget) && latencyTarget > 0.0))
+		{
+			break;
+		}
+
+		printf("Input was invalid, try again\n");
+	}
+
+	bool translate = GetTranslate();
+	std::string modelPath = GetModel();
+	PreloadWhisperContext(modelPath);
+
+	FILE* iqFile = fopen(sourcePath.c_str(), "rb");
+	if (iqFile == nullptr)
+	{
+		printf("failed to open %s\n", sourcePath.c_str());
+		return;
+	}
+
+	double carrierOffset;
+	std::vector<DecimationStage> plan = PlanFrontEnd(source, OutSampleRate, &carrierOffset);
+	BasebandConverter converter(plan, carrierOffset, source.CorrectCarrierOffset);
+	FmDemodulator demodulator;
+	AutomaticGainControl agc(OutSampleRate);
+
+	StreamingTranscriber transcriber(modelPath, nullptr, latencyTarget, "auto", std::thread::hardware_concurrency(), translate);
+	if (!transcriber.IsLoaded())
+	{
+		fclose(iqFile);
+		return;
+	}
+
+	printf("Listening to %s\n", sourcePath.c_str());
+
+	std::vector<std::complex<float>> block(IQBlockSize);
+	std::vector<float> audio(IQBlockSize);
+
+	/* fread waits for the writer on a pipe, so this runs at the pace the IQ comes in */
+	for (size_t blockCount; (blockCount = fread(block.data(), sizeof(std::complex<float>), IQBlockSize, iqFile)) != 0;)
+	{
+		size_t decimatedCount = converter.Process(block.data(), blockCount);
+		demodulator.Process(block.data(), decimatedCount, audio.data());
+
+		size_t written = agc.Process(audio.data(), decimatedCount, audio.data());
+		transcriber.Push(audio.data(), written);
+	}
+
+	audio.resize(std::max(audio.size(), agc.PendingCount()));
+	transcriber.Push(audio.data(), agc.Flush(audio.data()));
+
+	fclose(iqFile);
+	transcriber.Finish();
+
+	printf("\nStream ended, average latency: %.2f sec\n", transcriber.GetAverageLatency());
+	FreeWhisperContext();
+}
+
+/// <summary>
+/// asks for a clip already at whisper's sample rate (like the WAV files transcribe writes) and reads it
+/// </summary>
+/// <param name="name">- what the clip is for, in the prompt</param>
+/// <returns>samples, empty if it couldn't be used</returns>
+ArrayWrapper<float> GetWhisperClip(const std::string& name)
+{
+	std::string clipPath;
+	printf("Input path to the %s (16KHz mono WAV, like the ones transcribe writes): ", name.c_str());
+	std::getline(std::cin, clipPath);
+	clipPath = NosLib::String::Trim(clipPath);
+
+	WavFormat format;
+	ArrayWrapper<float> audio = ReadFile(clipPath, &format);
+	if (audio.size == 0)
+	{
+		return audio;
+	}
+
+	if (format.SampleRate != WHISPER_SAMPLE_RATE || format.Channels != 1)
+	{
+		printf("%s has to be %dHz mono (is %uHz, %u channels)\n", name.c_str(), WHISPER_SAMPLE_RATE, format.SampleRate, format.Channels);
+		audio.Delete();
+		return ArrayWrapper<float>();
+	}
+
+	return audio;
+}
+
+/// <summary>
+/// transcribes a reference clip with each model (and decoding profile) and compares them on speed (real time factor), memory (peak RSS)
+/// and accuracy (word error rate against a reference transcript), to pick a model for the hardware it runs on
+/// </summary>
+void BenchModels()
+{
+	ArrayWrapper<float> audio = GetWhisperClip("reference clip");
+	if (audio.size == 0)
+	{
+		return;
+	}
+
+	std::string referencePath;
+	printf("\nInput path to the reference transcript (text file, in english as the transcripts get translated): ");
+	std::getline(std::cin, referencePath);
+	referencePath = NosLib::String::Trim(referencePath);
+
+	std::ifstream referenceStream(referencePath);
+	if (!referenceStream.is_open())
+	{
+		printf("failed to open %s\n", referencePath.c_str());
+		audio.Delete();
+		return;
+	}
+
+	std::stringstream referenceText;
+	referenceText << referenceStream.rdbuf();
+	std::vector<std::string> referenceWords = NormaliseWords(referenceText.str());
+
+	/* by default every catalogue model that has already been downloaded */
+	std::vector<std::string> models;
+	for (const std::vector<std::string>& family : ModelCatalogue)
+	{
+		for (const std::string& name : family)
+		{
+			if (std::filesystem::exists(CatalogueModelFile(name)))
+			{
+				models.push_back(name);
+			}
+		}
+	}
+
+	std::string input;
+	printf("\nInput models to compare (names get downloaded if needed, or paths) [Separate each with ,]\n[Default = every downloaded model (%zu)]: ", models.size());
+	std::getline(std::cin, input);
+
+	if (!NosLib::String::Trim(input).empty())
+	{
+		NosLib::DynamicArray<std::string> splitOut;
+		NosLib::String::Split<char>(&splitOut, input, ',');
+
+		models.clear();
+		for (int i = 0; i <= splitOut.GetLastArrayIndex(); i++)
+		{
+			models.push_back(NosLib::String::Trim(splitOut[i]));
+		}
+	}
+
+	if (models.empty())
+	{
+		printf("no models to compare\n");
+		audio.Delete();
+		return;
+	}
+
+	std::vector<DecodingProfile> profiles;
+	while (true)
+	{
+		printf("\nInput decoding profiles to compare [Separate each with ,]\n[Default = every profile]: ");
+		std::getline(std::cin, input);
+
+		NosLib::DynamicArray<std::string> splitOut;
+		NosLib::String::Split<char>(&splitOut, input, ',');
+
+		profiles.clear();
+		bool valid = true;
+		for (int i = 0; i <= splitOut.GetLastArrayIndex(); i++)
+		{
+			std::string name = NosLib::String::Trim(splitOut[i]);
+			const DecodingProfile* profile = FindDecodingProfile(name);
+
+			if (profile != nullptr)
+			{
+				profiles.push_back(*profile);
+			}
+			else if (!name.empty())
+			{
+				valid = false;
+			}
+		}
+
+		if (!valid)
+		{
+			printf("Input was invalid, try again\n");
+			continue;
+		}
+
+		if (profiles.empty())
+		{
+			profiles = DecodingProfiles;
+		}
+		break;
+	}
+
+	printf("\nReference clip: %.1f sec, %zu word\\s\n", double(audio.size) / WHISPER_SAMPLE_RATE, referenceWords.size());
+
+	std::vector<ModelBenchmark> results;
+	for (const std::string& model : models)
+	{
+		printf("\nBenchmarking %s\n", model.c_str());
+		for (ModelBenchmark& result : BenchmarkModel(ResolveModel(model), audio, referenceWords, profiles))
+		{
+			result.Model = model;
+			results.push_back(result);
+		}
+	}
+
+	printf("\n%-24s %-10s %10s %8s %12s %8s\n", "model", "profile", "load (s)", "RTF", "peak RSS", "WER");
+	for (const ModelBenchmark& result : results)
+	{
+		if (!result.Loaded)
+		{
+			printf("%-24s %-10s %10s\n", result.Model.c_str(), result.Profile.c_str(), "failed");
+			continue;
+		}
+
+		printf("%-24s %-10s %10.2f %8.3f %9.0f MB %7.1f%%\n", result.Model.c_str(), result.Profile.c_str(), result.LoadTime, result.RealTimeFactor,
+			double(result.PeakMemory) / (1024.0 * 1024.0), result.WordErrorRate * 100.0);
+	}
+
+	audio.Delete();
+}
+
+/// <summary>
+/// tunes the threads for a model on demand (transcribe and export otherwise tune on the first audio they queue, the first time a model is used).
+/// the result is saved for this host, model and decoding profile and used from then on
+/// </summary>
+void TuneModelThreads()
+{
+	ArrayWrapper<float> audio = GetWhisperClip("calibration clip");
+	if (audio.size == 0)
+	{
+		return;
+	}
+
+	std::string modelPath = GetModel();
+	DecodingProfile decodingProfile = GetDecodingProfile();
+
+	if (LoadWhisperContext(modelPath))
+	{
+		ThreadConfiguration best = TuneThreads(audio.data, std::min(audio.size, size_t(TuningClipLength * WHISPER_SAMPLE_RATE)), "auto", std::thread::hardware_concurrency(), decodingProfile);
+		SaveThreadConfiguration(modelPath, decodingProfile.Name, best);
+
+		printf("\nSaved for %s (%s profile): %zu batches at once, %d threads each\n", GetHostName().c_str(), decodingProfile.Name.c_str(), best.JobSlots, best.ThreadsPerJob);
+	}
+
+	audio.Delete();
+	FreeWhisperContext();
+}
+
+/// <summary>
+/// fixes WAV files that were left behind by an interrupted run
+/// </summary>
+void RecoverFiles()
+{
+	std::string paths;
+	printf("Input path to WAV file\\s [Separate each path with ,]: ");
+	std::getline(std::cin, paths);
+
+	NosLib::DynamicArray<std::string> splitOut;
+	NosLib::String::Split<char>(&splitOut, paths, ',');
+
+	for (int i = 0; i <= splitOut.GetLastArrayIndex(); i++)
+	{
+		RecoverWav(NosLib::String::Trim(splitOut[i]));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string mode;
+
+	if (argc > 1)
+	{
+		mode = argv[1];
+	}
+	else
+	{
+		printf("Please choose a mode\ntranscribe\nscan\nexport (a clip and index entry per transmission)\nlive (transcribe IQ as it comes in)\nbench-models (compare models on a reference clip)\ntune (find the fastest thread setup for a model)\nrecover (fix WAV files from an interrupted run)\n[Default = transcribe]: ");
+		std::getline(std::cin, mode);
+	}
+
+	if (mode == "scan")
+	{
+		ScanFiles();
+	}
+	else if (mode == "export")
+	{
+		ExportFiles();
+	}
+	else if (mode == "live")
+	{
+		LiveTranscribe();
+	}
+	else if (mode == "bench-models" || mode == "lvatt-bench-models") /* also takes its full name */
+	{
+		BenchModels();
+	}
+	else if (mode == "tune")
+	{
+		TuneModelThreads();
+	}
+	else if (mode == "recover")
+	{
+		RecoverFiles();
+	}
+	else
+	{
+		TranscribeFiles();
+	}
 
 	printf("Press any button to continue"); std::cin.get();
 	return 0;
-}
\ No newline at end of file
+}